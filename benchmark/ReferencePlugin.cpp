@@ -0,0 +1,118 @@
+// JUCE Anagram LV2 Wrapper
+// Copyright (C) 2025 Filipe Coelho <falktx@darkglass.com>
+// SPDX-License-Identifier: ISC
+
+// Reference plugin for benchmarking the wrapper against several JUCE versions.
+// Deterministic and simple on purpose, so that measured differences come from JUCE and the wrapper, not the DSP.
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include "juce_anagram.h"
+
+namespace
+{
+
+class SmoothedParameter : public juce::AudioParameterFloat,
+                          public anagram::AudioParameterWithSmoothing
+{
+public:
+    using juce::AudioParameterFloat::AudioParameterFloat;
+
+    double getSmoothingTimeInSeconds() const override
+    {
+        return 0.05;
+    }
+};
+
+class ReferenceProcessor : public juce::AudioProcessor,
+                           public anagram::AudioProcessorWithMeters
+{
+public:
+    ReferenceProcessor()
+        : juce::AudioProcessor (BusesProperties()
+                                    .withInput ("Input", juce::AudioChannelSet::stereo(), true)
+                                    .withOutput ("Output", juce::AudioChannelSet::stereo(), true)),
+          anagram::AudioProcessorWithMeters ({ { "peak", "Peak", 0.f, 1.f, {} } })
+    {
+        addParameter (bypass = new juce::AudioParameterBool (juce::ParameterID { "bypass", 1 }, "Bypass", false));
+        addParameter (gain = new SmoothedParameter (juce::ParameterID { "gain", 1 }, "Gain", 0.f, 2.f, 1.f));
+        addParameter (drive = new juce::AudioParameterFloat (juce::ParameterID { "drive", 1 }, "Drive", 1.f, 10.f, 2.f));
+        addParameter (tone = new juce::AudioParameterFloat (juce::ParameterID { "tone", 1 }, "Tone", 0.01f, 1.f, 0.5f));
+    }
+
+    const juce::String getName() const override { return "Anagram LV2 Benchmark"; }
+    bool acceptsMidi() const override { return false; }
+    bool producesMidi() const override { return false; }
+    double getTailLengthSeconds() const override { return 0.0; }
+
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram (int) override {}
+    const juce::String getProgramName (int) override { return {}; }
+    void changeProgramName (int, const juce::String&) override {}
+
+    bool hasEditor() const override { return false; }
+    juce::AudioProcessorEditor* createEditor() override { return nullptr; }
+
+    void getStateInformation (juce::MemoryBlock&) override {}
+    void setStateInformation (const void*, int) override {}
+
+    juce::AudioProcessorParameter* getBypassParameter() const override
+    {
+        return bypass;
+    }
+
+    void prepareToPlay (double, int) override
+    {
+        reset();
+    }
+
+    void releaseResources() override {}
+
+    void reset() override
+    {
+        std::fill (std::begin (lowpass), std::end (lowpass), 0.f);
+    }
+
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
+    {
+        const int numSamples = buffer.getNumSamples();
+        const float* const gains = gain->getSmoothedValues();
+        const float gainValue = gain->get();
+        const float driveValue = drive->get();
+        const float toneValue = tone->get();
+        float peak = 0.f;
+
+        for (int c = 0; c < std::min (buffer.getNumChannels(), 2); ++c)
+        {
+            float* const data = buffer.getWritePointer (c);
+            float state = lowpass[c];
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const float shaped = std::tanh (data[i] * driveValue);
+                state += toneValue * (shaped - state);
+                data[i] = state * (gains != nullptr ? gains[i] : gainValue);
+            }
+
+            lowpass[c] = state;
+            peak = std::max (peak, getPeak (data, numSamples));
+        }
+
+        setMeterValue (0, peak);
+    }
+
+private:
+    juce::AudioParameterBool* bypass;
+    SmoothedParameter* gain;
+    juce::AudioParameterFloat* drive;
+    juce::AudioParameterFloat* tone;
+    float lowpass[2] {};
+};
+
+}
+
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
+{
+    return new ReferenceProcessor();
+}
@@ -0,0 +1,104 @@
+// JUCE Anagram LV2 Wrapper
+// Copyright (C) 2025 Filipe Coelho <falktx@darkglass.com>
+// SPDX-License-Identifier: ISC
+
+// Benchmark runner, loads a plugin binary built with `ENABLE_BENCHMARK` and runs its exported benchmark.
+// Usage: anagram-lv2-benchmark <plugin binary> [baseline file]
+//
+// The baseline file has one line per JUCE version:
+// `<JUCE version> <instantiate time in microseconds> <processing time in nanoseconds per sample>`
+// Returns 2 if the results regress more than 15% against the baseline of the JUCE version the plugin was built with.
+// When no baseline exists for that version, the results are printed in the expected format instead.
+
+#include <lv2/core/lv2.h>
+
+#include <dlfcn.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// NOTE keep in sync with the extension data in juce_audio_plugin_client_Anagram_LV2.cpp
+struct Benchmark
+{
+    const char* juceVersion;
+    int (*run) (double*, double*);
+};
+
+int main (int argc, char* argv[])
+{
+    constexpr double tolerance = 1.15;
+
+    if (argc < 2 || argc > 3)
+    {
+        fprintf (stderr, "Usage: %s <plugin binary> [baseline file]\n", argv[0]);
+        return 1;
+    }
+
+    void* const lib = dlopen (argv[1], RTLD_NOW | RTLD_LOCAL);
+
+    if (lib == nullptr)
+    {
+        fprintf (stderr, "Failed to load plugin binary: %s\n", dlerror());
+        return 1;
+    }
+
+    const auto descriptorFn = reinterpret_cast<LV2_Descriptor_Function> (dlsym (lib, "lv2_descriptor"));
+    const LV2_Descriptor* const descriptor = descriptorFn != nullptr ? descriptorFn (0) : nullptr;
+    const auto* const benchmark = descriptor != nullptr
+                                ? static_cast<const Benchmark*> (descriptor->extension_data ("http://www.darkglass.com/lv2/ns#benchmark"))
+                                : nullptr;
+
+    if (benchmark == nullptr)
+    {
+        fprintf (stderr, "Plugin binary does not export a benchmark, was it built with ENABLE_BENCHMARK?\n");
+        dlclose (lib);
+        return 1;
+    }
+
+    double instantiateMicroseconds = 0.0;
+    double nanosecondsPerSample = 0.0;
+
+    if (benchmark->run (&instantiateMicroseconds, &nanosecondsPerSample) != 0)
+    {
+        dlclose (lib);
+        return 1;
+    }
+
+    const std::string juceVersion = benchmark->juceVersion;
+    dlclose (lib);
+
+    printf ("JUCE %s, instantiate %.1f us, %.3f ns/sample\n",
+            juceVersion.c_str(), instantiateMicroseconds, nanosecondsPerSample);
+
+    if (argc == 2)
+        return 0;
+
+    std::ifstream baselineFile (argv[2]);
+    std::string line;
+
+    while (std::getline (baselineFile, line))
+    {
+        std::istringstream tokens (line);
+        std::string version;
+        double baselineInstantiate, baselineNanosecondsPerSample;
+
+        if (! (tokens >> version >> baselineInstantiate >> baselineNanosecondsPerSample) || version != juceVersion)
+            continue;
+
+        if (instantiateMicroseconds > baselineInstantiate * tolerance
+            || nanosecondsPerSample > baselineNanosecondsPerSample * tolerance)
+        {
+            fprintf (stderr, "Performance regressed against baseline \"%s\"\n", line.c_str());
+            return 2;
+        }
+
+        return 0;
+    }
+
+    printf ("No baseline for this JUCE version, add this line to the baseline file:\n%s %.1f %.3f\n",
+            juceVersion.c_str(), instantiateMicroseconds, nanosecondsPerSample);
+    return 0;
+}
@@ -0,0 +1,51 @@
+#!/bin/bash
+# JUCE Anagram LV2 Wrapper
+# Copyright (C) 2025 Filipe Coelho <falktx@darkglass.com>
+# SPDX-License-Identifier: ISC
+
+# Build the reference plugin against each given JUCE version and run its benchmark.
+# Usage: run-benchmarks.sh [JUCE version...]
+#
+# Environment variables:
+#   BASELINE   baseline file to compare against (machine-specific, see anagram-lv2-benchmark.cpp)
+#   BUILD_DIR  where JUCE checkouts and builds are kept, defaults to "build-benchmark" in the current directory
+#   JUCE_GIT   JUCE git repository to clone from
+
+set -e
+
+cd "$(dirname "${0}")"
+BENCHMARK_DIR="$(pwd)"
+cd - > /dev/null
+
+BUILD_DIR="${BUILD_DIR:-$(pwd)/build-benchmark}"
+JUCE_GIT="${JUCE_GIT:-https://github.com/juce-framework/JUCE.git}"
+
+if [ -n "${BASELINE}" ]; then
+    BASELINE="$(realpath "${BASELINE}")"
+fi
+
+if [ $# -eq 0 ]; then
+    set -- 7.0.12 8.0.4 8.0.10
+fi
+
+failed=0
+
+for version in "${@}"; do
+    juce_dir="${BUILD_DIR}/JUCE-${version}"
+    build_dir="${BUILD_DIR}/build-${version}"
+
+    if [ ! -d "${juce_dir}" ]; then
+        git clone --depth 1 --branch "${version}" "${JUCE_GIT}" "${juce_dir}"
+    fi
+
+    cmake -S "${BENCHMARK_DIR}" -B "${build_dir}" \
+        -DCMAKE_BUILD_TYPE=Release \
+        -DJUCE_DIR="${juce_dir}" \
+        -DANAGRAM_LV2_BENCHMARK_BASELINE="${BASELINE}"
+
+    if ! cmake --build "${build_dir}" --target benchmark -j "$(nproc)"; then
+        failed=1
+    fi
+done
+
+exit ${failed}
@@ -4,6 +4,15 @@
 
 #include <juce_core/juce_core.h>
 
+#include <atomic>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 namespace anagram
 {
 
@@ -25,4 +34,148 @@ public:
     virtual juce::Array<AudioParameterScalePoint> getAllScalePoints() const = 0;
 };
 
+// Class for letting the wrapper smooth a parameter
+// Whenever the related control port changes, the wrapper ramps linearly from the current to the new value
+// over the time given by this class, and provides the per-sample values of the ramp during processBlock.
+// The parameter itself is updated once per block with the value at the end of the ramp segment.
+class AudioParameterWithSmoothing
+{
+public:
+    virtual ~AudioParameterWithSmoothing() {};
+    virtual double getSmoothingTimeInSeconds() const = 0;
+
+    // Per-sample values (in plain, non-normalised range) for the block currently being processed
+    // Returns nullptr while the parameter is not moving, in which case its regular value applies to the whole block
+    // Only valid during processBlock
+    const float* getSmoothedValues() const noexcept { return smoothedValues; }
+
+    // Used by the wrapper, do not call this yourself
+    void setSmoothedValues (const float* const values) noexcept { smoothedValues = values; }
+
+private:
+    const float* smoothedValues = nullptr;
+};
+
+// Description of a plugin-owned meter, exported as an LV2 output control port
+struct AudioProcessorMeter
+{
+    juce::String symbol;
+    juce::String name;
+    float minimum;
+    float maximum;
+    juce::String label; // "dB" is exported as LV2 dB unit, same as for parameters
+
+    // How values of the left and right channel filters are combined, for plugins using a 2nd filter in dual-mono mode
+    enum DualMonoMode { kDualMonoMaximum, kDualMonoMinimum, kDualMonoLeftOnly };
+    DualMonoMode dualMono = kDualMonoMaximum;
+};
+
+// Class for reporting values (gain reduction, tuner pitch, levels, etc) back to the host
+// The DSP writes values through atomics, which the wrapper then copies into output control ports at a decimated rate.
+// Plugin processors that want meters should inherit from this class in addition to juce::AudioProcessor.
+class AudioProcessorWithMeters
+{
+public:
+    explicit AudioProcessorWithMeters (juce::Array<AudioProcessorMeter> meters_)
+        : meters (std::move (meters_)),
+          values (new std::atomic<float>[static_cast<size_t> (meters.size())])
+    {
+        for (int i = 0; i < meters.size(); ++i)
+            values[static_cast<size_t> (i)].store (meters.getReference (i).minimum);
+    }
+
+    virtual ~AudioProcessorWithMeters() {};
+
+    const juce::Array<AudioProcessorMeter>& getMeters() const noexcept
+    {
+        return meters;
+    }
+
+    // Realtime safe, meant to be called from processBlock
+    void setMeterValue (const int index, const float value) noexcept
+    {
+        values[static_cast<size_t> (index)].store (value, std::memory_order_relaxed);
+    }
+
+    float getMeterValue (const int index) const noexcept
+    {
+        return values[static_cast<size_t> (index)].load (std::memory_order_relaxed);
+    }
+
+    // Absolute peak of a block of samples
+    static float getPeak (const float* const data, const int numSamples) noexcept
+    {
+        int i = 0;
+        float peak = 0.f;
+
+       #if defined(__SSE__) || defined(_M_X64)
+        const __m128 signMask = _mm_set1_ps (-0.f);
+        __m128 acc = _mm_setzero_ps();
+
+        for (; i + 4 <= numSamples; i += 4)
+            acc = _mm_max_ps (acc, _mm_andnot_ps (signMask, _mm_loadu_ps (data + i)));
+
+        alignas (16) float lanes[4];
+        _mm_store_ps (lanes, acc);
+        peak = std::max (std::max (lanes[0], lanes[1]), std::max (lanes[2], lanes[3]));
+       #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        float32x4_t acc = vdupq_n_f32 (0.f);
+
+        for (; i + 4 <= numSamples; i += 4)
+            acc = vmaxq_f32 (acc, vabsq_f32 (vld1q_f32 (data + i)));
+
+        peak = std::max (std::max (vgetq_lane_f32 (acc, 0), vgetq_lane_f32 (acc, 1)),
+                         std::max (vgetq_lane_f32 (acc, 2), vgetq_lane_f32 (acc, 3)));
+       #endif
+
+        for (; i < numSamples; ++i)
+            peak = std::max (peak, std::abs (data[i]));
+
+        return peak;
+    }
+
+    // Root mean square of a block of samples
+    static float getRMS (const float* const data, const int numSamples) noexcept
+    {
+        if (numSamples <= 0)
+            return 0.f;
+
+        int i = 0;
+        float sum = 0.f;
+
+       #if defined(__SSE__) || defined(_M_X64)
+        __m128 acc = _mm_setzero_ps();
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const __m128 v = _mm_loadu_ps (data + i);
+            acc = _mm_add_ps (acc, _mm_mul_ps (v, v));
+        }
+
+        alignas (16) float lanes[4];
+        _mm_store_ps (lanes, acc);
+        sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+       #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        float32x4_t acc = vdupq_n_f32 (0.f);
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const float32x4_t v = vld1q_f32 (data + i);
+            acc = vmlaq_f32 (acc, v, v);
+        }
+
+        sum = vgetq_lane_f32 (acc, 0) + vgetq_lane_f32 (acc, 1) + vgetq_lane_f32 (acc, 2) + vgetq_lane_f32 (acc, 3);
+       #endif
+
+        for (; i < numSamples; ++i)
+            sum += data[i] * data[i];
+
+        return std::sqrt (sum / static_cast<float> (numSamples));
+    }
+
+private:
+    const juce::Array<AudioProcessorMeter> meters;
+    const std::unique_ptr<std::atomic<float>[]> values;
+};
+
 }
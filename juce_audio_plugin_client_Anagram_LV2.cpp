@@ -41,6 +41,10 @@
 
 #include "juce_anagram.h"
 
+#if JucePlugin_LV2Oversampling
+#include <juce_dsp/juce_dsp.h>
+#endif
+
 #include <lv2/core/lv2_util.h>
 #include <lv2/log/logger.h>
 
@@ -49,8 +53,49 @@
 #include <libmodla.h>
 #endif
 
+#ifndef JucePlugin_LV2MeterUpdateRate
+#define JucePlugin_LV2MeterUpdateRate 30
+#endif
+
+#if JucePlugin_LV2Oversampling && ! defined(JucePlugin_LV2OversamplingQuality)
+#define JucePlugin_LV2OversamplingQuality 1
+#endif
+
+#if JucePlugin_LV2MemoryBudget || JucePlugin_LV2StressTest || JucePlugin_LV2Benchmark
+#define ENABLE_HEADLESS_HOST
+#endif
+
+#include <atomic>
 #include <fstream>
 
+#if JucePlugin_LV2EnableTracing
+#include <chrono>
+#endif
+
+#if JucePlugin_LV2OutputGuard
+ #if defined(__SSE2__) || defined(_M_X64)
+  #include <emmintrin.h>
+ #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #include <arm_neon.h>
+ #endif
+#endif
+
+#if JucePlugin_LV2StressTest && ! JucePlugin_LV2MemoryAccounting
+#error The stress test relies on memory accounting for detecting allocations during run
+#endif
+
+#if JucePlugin_LV2MemoryAccounting && ! JUCE_LINUX
+#error Memory accounting relies on GNU ld symbol wrapping, only available on Linux
+#endif
+
+#if JucePlugin_LV2MemoryAccounting
+#include <malloc.h>
+#endif
+
+#if JucePlugin_LV2AsyncInstantiate && defined(ENABLE_JUCE_GUI)
+#error Asynchronous instantiation creates the plugin filter outside of the message thread, which is incompatible with GUI
+#endif
+
 namespace juce::anagram_lv2_client
 {
 
@@ -76,303 +121,2366 @@ static inline String sanitiseStringAsSymbol (const String& input, int index)
     return String (CharPointer_UTF32 { sanitised.data() }, sanitised.size());
 }
 
-class JuceLv2Wrapper
+static inline String getParameterSymbol (AudioProcessorParameter* const parameter, int index)
 {
-public:
-    // set to true if plugin initializes properly
-    bool ok = false;
+    return sanitiseStringAsSymbol (URL::addEscapeChars (LegacyAudioParameter::getParamID (parameter, false), true), index);
+}
 
-    JuceLv2Wrapper(double sampleRate, int32_t bufferSize, LV2_Log_Logger& logger, LV2_URID_Map* uridMap)
+// Collect the normalised parameter values of every plugin program, stored as numPrograms * numParameters.
+// Switches through all programs and restores the original plugin state afterwards, so never call this from RT.
+// NOTE only parameters are snapshotted, any other program state is not (and cannot be, in a realtime safe way)
+static Array<float> getAllProgramValues (AudioProcessor& filter)
+{
+    const Array<AudioProcessorParameter*>& parameters = filter.getParameters();
+    const int numPrograms = filter.getNumPrograms();
+    const int numParameters = parameters.size();
+
+    Array<float> values;
+    values.resize (numPrograms * numParameters);
+
+    MemoryBlock state;
+    filter.getStateInformation (state);
+    const int currentProgram = filter.getCurrentProgram();
+
+    for (int p = 0; p < numPrograms; ++p)
     {
-        {
-           #ifdef ENABLE_JUCE_GUI
-            const MessageManagerLock mmLock;
-           #endif
-            filter = createPluginFilterOfType (AudioProcessor::wrapperType_LV2);
-        }
+        filter.setCurrentProgram (p);
 
-        // Stop here if createPluginFilterOfType failed
-        if (filter == nullptr)
-        {
-            lv2_log_error (&logger, "Failed to create plugin filter\n");
-            return;
-        }
+        for (int i = 0; i < numParameters; ++i)
+            values.setUnchecked (p * numParameters + i, parameters.getUnchecked (i)->getValue());
+    }
 
-       #ifdef JucePlugin_PreferredChannelConfigurations
-        constexpr int configs[][2] = { JucePlugin_PreferredChannelConfigurations };
-        filter->setPlayConfigDetails (configs[0][0], configs[0][1], sampleRate, bufferSize);
-       #else
-        filter->enableAllBuses();
-       #endif
-        filter->refreshParameterList();
+    filter.setCurrentProgram (currentProgram);
+    filter.setStateInformation (state.getData(), static_cast<int> (state.getSize()));
 
-        const Array<AudioProcessorParameter*>& parameters = filter->getParameters();
+    return values;
+}
 
-        numInputs = filter->getTotalNumInputChannels();
-        numOutputs = filter->getTotalNumOutputChannels();
-        numControls = parameters.size();
-        bypassParameter = filter->getBypassParameter();
+// Create and setup a plugin filter instance, returns null on failure
+static std::unique_ptr<AudioProcessor> createFilter (double sampleRate, int32_t bufferSize)
+{
+    std::unique_ptr<AudioProcessor> filter;
 
-        // Stop here if filter has Anagram incompatible IO
-        if (numInputs < 1 || numOutputs < 1 || numInputs > 2 || numOutputs > 2)
-        {
-            lv2_log_error (&logger, "Plugin filter has Anagram incompatible IO\n");
-            return;
-        }
+    {
+       #ifdef ENABLE_JUCE_GUI
+        const MessageManagerLock mmLock;
+       #endif
+        filter = createPluginFilterOfType (AudioProcessor::wrapperType_LV2);
+    }
 
-        // Stop here if filter is missing bypass parameter
-        if (bypassParameter == nullptr)
-        {
-            lv2_log_error (&logger, "Plugin filter is missing bypass parameter, required for Anagram\n");
-            return;
-        }
+    if (filter == nullptr)
+        return {};
 
-        // Stop here if filter has no parameters
-        if (numControls <= 1)
-        {
-            lv2_log_error (&logger, "Plugin filter has no parameters, at least 1 is required for Anagram\n");
-            return;
-        }
+   #ifdef JucePlugin_PreferredChannelConfigurations
+    constexpr int configs[][2] = { JucePlugin_PreferredChannelConfigurations };
+    filter->setPlayConfigDetails (configs[0][0], configs[0][1], sampleRate, bufferSize);
+   #else
+    ignoreUnused (sampleRate, bufferSize);
+    filter->enableAllBuses();
+   #endif
+    filter->refreshParameterList();
 
-        host.sampleRate = sampleRate;
-        host.bufferSize = bufferSize;
-        host.logger = logger;
-        host.uridMap = uridMap;
+    return filter;
+}
 
-        ports.audioIns.resize(static_cast<size_t> (numInputs));
-        ports.audioOuts.resize(static_cast<size_t> (numOutputs));
-        ports.controls.resize(static_cast<size_t> (numControls));
-        lastControlValues.resize(static_cast<size_t> (numControls));
+#if JucePlugin_LV2DualMono
+// Mono plugins are exported as stereo, preferably by letting the filter itself process 2 channels.
+// Returns true if its bus layout does not allow that, in which case a 2nd filter is needed for the right channel.
+static bool setupDualMono (AudioProcessor& filter)
+{
+    if (filter.getTotalNumInputChannels() != 1 || filter.getTotalNumOutputChannels() != 1)
+        return false;
 
-        for (int i = 0; i < numControls; ++i)
-        {
-            AudioProcessorParameter* const parameter = parameters.getUnchecked (i);
+    AudioProcessor::BusesLayout layout = filter.getBusesLayout();
+    layout.inputBuses.getReference (0) = AudioChannelSet::stereo();
+    layout.outputBuses.getReference (0) = AudioChannelSet::stereo();
 
-            if (auto* rangedParameter = dynamic_cast<const RangedAudioParameter*> (parameter))
-                lastControlValues.setUnchecked(i, rangedParameter->convertFrom0to1 (rangedParameter->getValue()));
-            else
-                lastControlValues.setUnchecked(i, parameter->getValue());
-        }
+    return ! filter.setBusesLayout (layout);
+}
 
-        ok = true;
-    }
+#if JucePlugin_LV2DualMonoParallel
+// Realtime thread processing the right channel filter of a dual-mono instance, in parallel with the left one
+class DualMonoThread : private Thread
+{
+public:
+    DualMonoThread()
+        : Thread ("Anagram LV2 Dual Mono") {}
 
-    ~JuceLv2Wrapper()
+    ~DualMonoThread() override
     {
+        signalThreadShouldExit();
+        startEvent.signal();
+        stopThread (5000);
     }
 
-    void connect(int port, void* data)
+    // fails if the process is not allowed to use realtime scheduling
+    bool start()
     {
-        if (port < numInputs)
-        {
-            ports.audioIns.setUnchecked(port, static_cast<const float*> (data));
-            return;
-        }
-        port -= numInputs;
+        return startRealtimeThread (RealtimeOptions{});
+    }
 
-        if (port < numOutputs)
-        {
-            ports.audioOuts.setUnchecked(port, static_cast<float*> (data));
-            return;
-        }
-        port -= numOutputs;
+    void startProcessing (AudioProcessor& filter_, AudioSampleBuffer& buffer_, MidiBuffer& midiEvents_) noexcept
+    {
+        filter = &filter_;
+        buffer = &buffer_;
+        midiEvents = &midiEvents_;
+        startEvent.signal();
+    }
 
-        if (port-- == 0)
-        {
-            ports.enabled = static_cast<const float*> (data);
-            return;
-        }
+    void waitForProcessing() noexcept
+    {
+        doneEvent.wait();
+    }
 
-        if (port-- == 0)
-        {
-            ports.reset = static_cast<const float*> (data);
-            return;
-        }
+private:
+    void run() override
+    {
+        const ScopedNoDenormals snd;
 
-       #if JucePlugin_LV2WantsFreeWheel
-        if (port-- == 0)
+        for (;;)
         {
-            ports.freeWheel = static_cast<const float*> (data);
-            return;
-        }
-       #endif
+            startEvent.wait();
 
-       #if JucePlugin_LV2WantsLatency
-        if (port-- == 0)
-        {
-            ports.latency = static_cast<float*> (data);
-            return;
-        }
-       #endif
+            if (threadShouldExit())
+                break;
 
-        if (port < numControls)
-        {
-            ports.controls.setUnchecked(port, static_cast<float*> (data));
-            return;
+            filter->processBlock (*buffer, *midiEvents);
+            doneEvent.signal();
         }
-        // port -= numControls;
     }
 
-    void activate()
+    WaitableEvent startEvent;
+    WaitableEvent doneEvent;
+    AudioProcessor* filter = nullptr;
+    AudioSampleBuffer* buffer = nullptr;
+    MidiBuffer* midiEvents = nullptr;
+};
+#endif
+#endif
+
+// Shared low-priority thread for the non-realtime work of all plugin instances
+class BackgroundThread : private Thread
+{
+public:
+    struct Client
     {
-        filter->prepareToPlay (host.sampleRate, host.bufferSize);
-        filter->setPlayConfigDetails (numInputs, numOutputs, host.sampleRate, host.bufferSize);
+        virtual ~Client() = default;
+        virtual void backgroundIdle() = 0;
+    };
 
-        audioBuffers.calloc (std::max (numInputs, numOutputs));
+    BackgroundThread()
+        : Thread ("Anagram LV2 Background") {}
 
-       #ifdef ENABLE_MOD_LICENSING_API
-        licenseRunCount = 0;
-       #endif
+    ~BackgroundThread() override
+    {
+        stopThread (5000);
     }
 
-    void deactivate()
+    // never waits for client callbacks, the lock only guards the client list
+    void addClient (Client* const client)
     {
-        audioBuffers.free();
+        const ScopedLock sl (lock);
+        clients.addIfNotAlreadyThere (client);
 
-        filter->releaseResources();
+        if (! isThreadRunning())
+            startThread();
     }
 
-    void run(int sampleCount)
+    // blocks until the background thread is done with this client, unless called from within a client callback
+    void removeClient (Client* const client)
     {
-        if (ports.reset != nullptr && *ports.reset > 0.5f)
-        {
-            filter->reset();
-           #ifdef ENABLE_MOD_LICENSING_API
-            licenseRunCount = 0;
-           #endif
-        }
-
-        if (ports.freeWheel != nullptr)
-            filter->setNonRealtime (*ports.freeWheel > 0.5f);
+        const ScopedLock sl (lock);
+        clients.removeFirstMatchingValue (client);
 
-        if (ports.latency != nullptr)
-            *ports.latency = filter->getLatencySamples();
+        if (isThisTheCurrentThread())
+            return;
 
-        if (sampleCount == 0)
+        while (currentClient == client)
         {
-            // LV2 pre-roll
-            // Hosts might use this to force plugins to update its output control ports.
-            // (plugins can only access port locations during run)
-            return;
+            const ScopedUnlock sul (lock);
+            clientDone.wait (10);
         }
+    }
 
-        // Check for updated parameters
+private:
+    void run() override
+    {
+        Array<Client*> pendingClients;
+
+        while (! threadShouldExit())
         {
-            const Array<AudioProcessorParameter*>& parameters = filter->getParameters();
-            float value;
+            wait (50);
 
-            for (int i = 0, offset = 0; i < numControls; ++i)
+            // callbacks run on a copy without holding the lock,
+            // so that clients can be added and removed at any time (including from within callbacks)
             {
-                AudioProcessorParameter* const parameter = parameters.getUnchecked (i);
+                const ScopedLock sl (lock);
+                pendingClients = clients;
+            }
 
-                if (parameter == bypassParameter)
+            for (Client* const client : pendingClients)
+            {
                 {
-                    ++offset;
-                    if (ports.enabled == nullptr)
+                    const ScopedLock sl (lock);
+
+                    // skip clients removed in the meantime
+                    if (! clients.contains (client))
                         continue;
-                    value = 1.f - *ports.enabled;
+
+                    currentClient = client;
                 }
-                else
+
+                client->backgroundIdle();
+
                 {
-                    if (ports.controls.getUnchecked(i - offset) == nullptr)
-                        continue;
-                    value = *ports.controls.getUnchecked(i - offset);
+                    const ScopedLock sl (lock);
+                    currentClient = nullptr;
                 }
 
-                if (approximatelyEqual(lastControlValues.getUnchecked(i), value))
-                    continue;
+                clientDone.signal();
+            }
+        }
+    }
 
-                lastControlValues.setUnchecked(i, value);
+    CriticalSection lock;
+    Array<Client*> clients;
+    Client* currentClient = nullptr; // client whose callback is running, guarded by lock
+    WaitableEvent clientDone;
+};
 
-                if (auto* rangedParameter = dynamic_cast<const RangedAudioParameter*> (parameter))
-                    value = rangedParameter->convertTo0to1 (value);
+#if JucePlugin_LV2EnableTracing
+// Per-instance realtime tracing, events are written lock-free from the audio thread into a fixed-size ring
+// and regularly drained by the background thread into a Chrome/Perfetto compatible JSON trace file.
+// Trace files are written into $ANAGRAM_LV2_TRACE_DIR, or the temporary directory if not set.
+class Tracer : private BackgroundThread::Client
+{
+public:
+    enum EventType : uint32_t {
+        kEventRunBegin,
+        kEventRunEnd,
+        kEventParameterChange,
+        kEventLockWait,
+        kEventReset,
+    };
 
-                parameter->setValueNotifyingHost (value);
-            }
+    explicit Tracer (const String& name)
+        : id (++lastInstanceId)
+    {
+        events.calloc (kRingSize);
+
+        File dir (SystemStats::getEnvironmentVariable ("ANAGRAM_LV2_TRACE_DIR", {}));
+        if (! dir.isDirectory())
+            dir = File::getSpecialLocation (File::tempDirectory);
+
+        const File file = dir.getNonexistentChildFile ("anagram-lv2-trace-" + sanitiseStringAsSymbol (name, 0), ".json");
+        stream = std::make_unique<FileOutputStream> (file);
+
+        if (stream->failedToOpen())
+        {
+            stream.reset();
+            return;
         }
 
-        // prepare audio buffers
+        *stream << "[\n"
+                << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << id
+                << ",\"args\":{\"name\":\"" << name.replace ("\"", "'") << " #" << id << "\"}}";
+
+        background->addClient (this);
+    }
+
+    ~Tracer() override
+    {
+        background->removeClient (this);
+
+        if (stream != nullptr)
         {
-            int i;
-            for (i = 0; i < numOutputs; ++i)
-            {
-                audioBuffers[i] = ports.audioOuts[i];
+            backgroundIdle();
 
-                if (i < numInputs && ports.audioIns[i] != ports.audioOuts[i])
-                    FloatVectorOperations::copy (ports.audioOuts[i], ports.audioIns[i], sampleCount);
-            }
-            for (; i < numInputs; ++i)
-                audioBuffers[i] = const_cast<float*>(ports.audioIns[i]);
+            if (numDroppedEvents.load() != 0)
+                *stream << ",\n{\"name\":\"dropped\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":" << id
+                        << ",\"ts\":" << String (getTime() / 1000.0, 3)
+                        << ",\"args\":{\"count\":" << static_cast<int> (numDroppedEvents.load()) << "}}";
+
+            *stream << "\n]\n";
         }
+    }
 
-        // TODO send MIDI events as needed
-        midiEvents.clear();
+    static inline int64_t getTime() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds> (
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // realtime safe, events are dropped if the ring is full
+    inline void push (const EventType type, const int64_t time, const int64_t duration = 0,
+                      const int32_t index = 0, const float value = 0.f) noexcept
+    {
+        const uint32_t write = writeIndex.load (std::memory_order_relaxed);
+        const uint32_t next = (write + 1) & (kRingSize - 1);
 
-        // process filter
+        if (next == readIndex.load (std::memory_order_acquire))
         {
-            AudioSampleBuffer chans (audioBuffers, std::max (numInputs, numOutputs), sampleCount);
+            numDroppedEvents.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
 
-            const ScopedLock sl (filter->getCallbackLock());
+        Event& event = events[write];
+        event.time = time;
+        event.duration = duration;
+        event.type = type;
+        event.index = index;
+        event.value = value;
 
-           #ifdef ENABLE_MOD_LICENSING_API
-            licenseRunCount = mod_license_run_begin(licenseRunCount, (uint32_t)sampleCount);
-           #endif
+        writeIndex.store (next, std::memory_order_release);
+    }
 
-            if (filter->isSuspended())
-            {
-                for (int i = 0; i < numOutputs; ++i)
-                    FloatVectorOperations::clear (ports.audioOuts[i], sampleCount);
-            }
-            else
+private:
+    struct Event {
+        int64_t time;
+        int64_t duration;
+        uint32_t type;
+        int32_t index;
+        float value;
+    };
+
+    static constexpr uint32_t kRingSize = 8192; // must be power of 2
+
+    void backgroundIdle() override
+    {
+        const uint32_t write = writeIndex.load (std::memory_order_acquire);
+        uint32_t read = readIndex.load (std::memory_order_relaxed);
+
+        if (read == write)
+            return;
+
+        for (; read != write; read = (read + 1) & (kRingSize - 1))
+        {
+            const Event& event = events[read];
+
+            *stream << ",\n{\"pid\":0,\"tid\":" << id << ",\"ts\":" << String (event.time / 1000.0, 3);
+
+            switch (event.type)
+            {
+            case kEventRunBegin:
+                *stream << ",\"name\":\"run\",\"ph\":\"B\",\"args\":{\"samples\":" << event.index << "}}";
+                break;
+            case kEventRunEnd:
+                *stream << ",\"name\":\"run\",\"ph\":\"E\"}";
+                break;
+            case kEventParameterChange:
+                *stream << ",\"name\":\"parameter\",\"ph\":\"i\",\"s\":\"t\""
+                           ",\"args\":{\"index\":" << event.index << ",\"value\":" << String (event.value) << "}}";
+                break;
+            case kEventLockWait:
+                *stream << ",\"name\":\"lock\",\"ph\":\"X\",\"dur\":" << String (event.duration / 1000.0, 3) << "}";
+                break;
+            case kEventReset:
+                *stream << ",\"name\":\"reset\",\"ph\":\"i\",\"s\":\"t\"}";
+                break;
+            }
+        }
+
+        readIndex.store (read, std::memory_order_release);
+        stream->flush();
+    }
+
+    static inline std::atomic<int> lastInstanceId { 0 };
+    const int id;
+
+    SharedResourcePointer<BackgroundThread> background;
+    std::unique_ptr<FileOutputStream> stream;
+
+    HeapBlock<Event> events;
+    std::atomic<uint32_t> readIndex { 0 };
+    std::atomic<uint32_t> writeIndex { 0 };
+    std::atomic<uint32_t> numDroppedEvents { 0 };
+};
+#endif
+
+#if JucePlugin_LV2OutputGuard
+// Check for NaN or Inf values, which have all exponent bits set
+// Does not exit early, we expect to almost never find anything so a branch-free loop is faster
+static inline bool hasNonFiniteValues (const float* const data, const int numSamples) noexcept
+{
+    int i = 0;
+    bool found = false;
+
+   #if defined(__SSE2__) || defined(_M_X64)
+    const __m128i exponentMask = _mm_set1_epi32 (0x7f800000);
+    __m128i acc = _mm_setzero_si128();
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const __m128i bits = _mm_castps_si128 (_mm_loadu_ps (data + i));
+        acc = _mm_or_si128 (acc, _mm_cmpeq_epi32 (_mm_and_si128 (bits, exponentMask), exponentMask));
+    }
+
+    found = _mm_movemask_epi8 (acc) != 0;
+   #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint32x4_t exponentMask = vdupq_n_u32 (0x7f800000);
+    uint32x4_t acc = vdupq_n_u32 (0);
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const uint32x4_t bits = vreinterpretq_u32_f32 (vld1q_f32 (data + i));
+        acc = vorrq_u32 (acc, vceqq_u32 (vandq_u32 (bits, exponentMask), exponentMask));
+    }
+
+    const uint32x2_t acc2 = vorr_u32 (vget_low_u32 (acc), vget_high_u32 (acc));
+    found = (vget_lane_u32 (acc2, 0) | vget_lane_u32 (acc2, 1)) != 0;
+   #endif
+
+    for (; i < numSamples; ++i)
+    {
+        uint32_t bits;
+        std::memcpy (&bits, data + i, sizeof (bits));
+        found |= (bits & 0x7f800000) == 0x7f800000;
+    }
+
+    return found;
+}
+
+// Protection against NaN or Inf values coming out of the plugin, which would otherwise poison the whole chain.
+// When found, the output is silenced and the filter gets reset on the background thread, after which output fades in.
+class OutputGuard : private BackgroundThread::Client
+{
+public:
+    OutputGuard (AudioProcessor& filter_, AudioProcessor* const twin_, const LV2_Log_Logger& logger_, const double sampleRate)
+        : filter (filter_),
+          twin (twin_),
+          logger (logger_),
+          rampLength (std::max (1, roundToInt (sampleRate * 0.01))),
+          rampPosition (rampLength)
+    {
+    }
+
+    ~OutputGuard() override
+    {
+        background->removeClient (this);
+    }
+
+    // resets are only handled between activate and deactivate, as they must not run while the filter is released
+    void activate()
+    {
+        background->addClient (this);
+    }
+
+    void deactivate()
+    {
+        background->removeClient (this);
+
+        // drop any pending reset, releaseResources and the next prepareToPlay take care of it
+        resetPending.store (false, std::memory_order_release);
+        rampPosition = rampLength;
+    }
+
+    // true while waiting for the background thread to reset the filter, outputs must be kept silent
+    bool isResetPending() const noexcept
+    {
+        return resetPending.load (std::memory_order_acquire);
+    }
+
+    // called after processing, from the realtime thread
+    void check (float* const* const outputs, const int numOutputs, const int numSamples) noexcept
+    {
+        if (isResetPending())
+            return;
+
+        bool found = false;
+        for (int i = 0; i < numOutputs; ++i)
+            found |= hasNonFiniteValues (outputs[i], numSamples);
+
+        if (found)
+        {
+            for (int i = 0; i < numOutputs; ++i)
+                FloatVectorOperations::clear (outputs[i], numSamples);
+
+            numEvents.fetch_add (1, std::memory_order_relaxed);
+            rampPosition = 0;
+            // NOTE the background thread is not woken up here, as that is not realtime safe
+            // the output is kept silent until its next regular interval picks up the reset
+            resetPending.store (true, std::memory_order_release);
+            return;
+        }
+
+        // fade in after a reset
+        if (rampPosition < rampLength)
+        {
+            const int numRampSamples = std::min (numSamples, rampLength - rampPosition);
+            const float start = static_cast<float> (rampPosition) / static_cast<float> (rampLength);
+            const float increment = 1.f / static_cast<float> (rampLength);
+
+            for (int i = 0; i < numOutputs; ++i)
+            {
+                float* const output = outputs[i];
+
+                for (int j = 0; j < numRampSamples; ++j)
+                    output[j] *= start + increment * static_cast<float> (j);
+            }
+
+            rampPosition += numRampSamples;
+        }
+    }
+
+private:
+    void backgroundIdle() override
+    {
+        if (! isResetPending())
+            return;
+
+        {
+            const ScopedLock sl (filter.getCallbackLock());
+            filter.reset();
+
+            if (twin != nullptr)
+            {
+                const ScopedLock sl2 (twin->getCallbackLock());
+                twin->reset();
+            }
+        }
+
+        resetPending.store (false, std::memory_order_release);
+
+        lv2_log_warning (&logger, "Plugin produced non-finite output and was reset, %u time(s) so far\n",
+                         numEvents.load (std::memory_order_relaxed));
+    }
+
+    AudioProcessor& filter;
+    AudioProcessor* const twin; // dual-mono right channel filter, can be null
+    LV2_Log_Logger logger;
+    SharedResourcePointer<BackgroundThread> background;
+
+    const int rampLength;
+    int rampPosition;
+
+    std::atomic<bool> resetPending { false };
+    std::atomic<uint32_t> numEvents { 0 };
+};
+#endif
+
+#if JucePlugin_LV2MemoryAccounting
+// Allocation counters for a single lifecycle phase of a plugin instance
+struct MemoryCounters
+{
+    size_t numAllocations = 0;
+    size_t numBytes = 0;
+};
+
+// Counters that allocations in the current thread are accounted to, see the allocation hooks at the end of this file
+static thread_local MemoryCounters* currentMemoryCounters = nullptr;
+
+static inline void countAllocation (const size_t size) noexcept
+{
+    if (MemoryCounters* const counters = currentMemoryCounters)
+    {
+        ++counters->numAllocations;
+        counters->numBytes += size;
+    }
+}
+
+// Account allocations of the current thread to some counters, null keeps using the previous ones
+class ScopedMemoryAccounting
+{
+public:
+    explicit ScopedMemoryAccounting (MemoryCounters* const counters) noexcept
+        : previous (currentMemoryCounters)
+    {
+        if (counters != nullptr)
+            currentMemoryCounters = counters;
+    }
+
+    ~ScopedMemoryAccounting() noexcept
+    {
+        currentMemoryCounters = previous;
+    }
+
+private:
+    MemoryCounters* const previous;
+    JUCE_DECLARE_NON_COPYABLE (ScopedMemoryAccounting)
+};
+#endif
+
+class JuceLv2Wrapper : private BackgroundThread::Client
+{
+public:
+    // set to true if plugin initializes properly
+    bool ok = false;
+
+   #if JucePlugin_LV2MemoryAccounting
+    // number of runs accounted for after each activate
+    static constexpr int kMemoryAccountingRuns = 16;
+
+    // allocations per lifecycle phase, instantiate is filled in by the LV2 instantiate callback
+    struct {
+        MemoryCounters instantiate;
+        MemoryCounters activate;
+        MemoryCounters run;
+        int numRuns = 0;
+    } memoryUsage;
+   #endif
+
+    JuceLv2Wrapper(double sampleRate, int32_t bufferSize, int32_t maxBufferSize, LV2_Log_Logger& logger, LV2_URID_Map* uridMap)
+    {
+        filter = createFilter (sampleRate, maxBufferSize);
+
+        // Stop here if createPluginFilterOfType failed
+        if (filter == nullptr)
+        {
+            lv2_log_error (&logger, "Failed to create plugin filter\n");
+            return;
+        }
+
+       #if JucePlugin_LV2DualMono
+        if (setupDualMono (*filter))
+        {
+            twin = createFilter (sampleRate, maxBufferSize);
+
+            // Stop here if the right channel filter could not be created or does not match the left one
+            if (twin == nullptr || twin->getParameters().size() != filter->getParameters().size())
+            {
+                lv2_log_error (&logger, "Failed to create plugin filter for dual-mono right channel\n");
+                return;
+            }
+
+           #if JucePlugin_LV2DualMonoParallel
+            dualMonoThread = std::make_unique<DualMonoThread>();
+
+            // waiting on a thread that never runs would block the audio thread forever
+            if (! dualMonoThread->start())
+            {
+                lv2_log_warning (&logger, "Failed to start realtime thread, processing dual-mono channels serially\n");
+                dualMonoThread.reset();
+            }
+           #endif
+        }
+
+        const int numFilters = twin != nullptr ? 2 : 1;
+       #else
+        constexpr int numFilters = 1;
+       #endif
+
+        const Array<AudioProcessorParameter*>& parameters = filter->getParameters();
+
+        numInputs = filter->getTotalNumInputChannels() * numFilters;
+        numOutputs = filter->getTotalNumOutputChannels() * numFilters;
+        numControls = parameters.size();
+        numPrograms = filter->getNumPrograms();
+        bypassParameter = filter->getBypassParameter();
+        meters = dynamic_cast<anagram::AudioProcessorWithMeters*> (filter.get());
+       #if JucePlugin_LV2DualMono
+        if (twin != nullptr && meters != nullptr)
+            twinMeters = dynamic_cast<anagram::AudioProcessorWithMeters*> (twin.get());
+       #endif
+        numMeters = meters != nullptr ? meters->getMeters().size() : 0;
+
+        // Stop here if filter has Anagram incompatible IO
+        if (numInputs < 1 || numOutputs < 1 || numInputs > 2 || numOutputs > 2)
+        {
+            lv2_log_error (&logger, "Plugin filter has Anagram incompatible IO\n");
+            return;
+        }
+
+        // Stop here if filter is missing bypass parameter
+        if (bypassParameter == nullptr)
+        {
+            lv2_log_error (&logger, "Plugin filter is missing bypass parameter, required for Anagram\n");
+            return;
+        }
+
+        // Stop here if filter has no parameters
+        if (numControls <= 1)
+        {
+            lv2_log_error (&logger, "Plugin filter has no parameters, at least 1 is required for Anagram\n");
+            return;
+        }
+
+        host.sampleRate = sampleRate;
+        host.bufferSize = bufferSize;
+        host.maxBufferSize = maxBufferSize;
+        host.logger = logger;
+        host.uridMap = uridMap;
+
+        ports.audioIns.resize(static_cast<size_t> (numInputs));
+        ports.audioOuts.resize(static_cast<size_t> (numOutputs));
+        ports.controls.resize(static_cast<size_t> (numControls));
+        ports.meters.resize(static_cast<size_t> (numMeters));
+        meterUpdateInterval = std::max (1, roundToInt (sampleRate / JucePlugin_LV2MeterUpdateRate));
+        lastControlValues.resize(static_cast<size_t> (numControls));
+
+        // precompute program snapshots, so switching programs during run is just a table lookup
+        if (numPrograms > 1)
+        {
+            programValues = getAllProgramValues (*filter);
+            lastProgram = filter->getCurrentProgram();
+        }
+
+        for (int i = 0; i < numControls; ++i)
+        {
+            AudioProcessorParameter* const parameter = parameters.getUnchecked (i);
+
+            if (auto* rangedParameter = dynamic_cast<const RangedAudioParameter*> (parameter))
+                lastControlValues.setUnchecked(i, rangedParameter->convertFrom0to1 (rangedParameter->getValue()));
+            else
+                lastControlValues.setUnchecked(i, parameter->getValue());
+        }
+
+        // setup wrapper-side smoothing for parameters that ask for it
+        smootherIndexes.insertMultiple (0, -1, numControls);
+
+        for (int i = 0; i < numControls; ++i)
+        {
+            AudioProcessorParameter* const parameter = parameters.getUnchecked (i);
+
+            if (auto* smoothing = dynamic_cast<anagram::AudioParameterWithSmoothing*> (parameter))
+            {
+                const int numSteps = roundToInt (smoothing->getSmoothingTimeInSeconds() * sampleRate);
+
+                if (numSteps <= 1)
+                    continue;
+
+                Smoother smoother;
+                smoother.index = i;
+                smoother.parameter = parameter;
+                smoother.smoothing = smoothing;
+               #if JucePlugin_LV2DualMono
+                if (twin != nullptr)
+                    smoother.twinSmoothing = dynamic_cast<anagram::AudioParameterWithSmoothing*> (
+                        twin->getParameters().getUnchecked (i));
+               #endif
+                smoother.numSteps = numSteps;
+                smoother.current = smoother.target = lastControlValues.getUnchecked (i);
+
+                smootherIndexes.setUnchecked (i, smoothers.size());
+                smoothers.add (smoother);
+            }
+        }
+
+       #if JucePlugin_LV2Oversampling
+        oversampling = createOversampling (JucePlugin_LV2OversamplingQuality);
+       #if JucePlugin_LV2WantsFreeWheel && JucePlugin_LV2OversamplingQuality < 2
+        freeWheelOversampling = createOversampling (2);
+       #endif
+       #endif
+
+       #if JucePlugin_LV2EnableTracing
+        tracer = std::make_unique<Tracer> (filter->getName());
+       #endif
+
+       #if JucePlugin_LV2OutputGuard
+       #if JucePlugin_LV2DualMono
+        outputGuard = std::make_unique<OutputGuard> (*filter, twin.get(), logger, sampleRate);
+       #else
+        outputGuard = std::make_unique<OutputGuard> (*filter, nullptr, logger, sampleRate);
+       #endif
+       #endif
+
+        ok = true;
+    }
+
+    ~JuceLv2Wrapper() override
+    {
+       #if JucePlugin_LV2FreeWheelBlockSize
+        background->removeClient (this);
+       #endif
+    }
+
+    void connect(int port, void* data)
+    {
+        if (port < numInputs)
+        {
+            ports.audioIns.setUnchecked(port, static_cast<const float*> (data));
+            return;
+        }
+        port -= numInputs;
+
+        if (port < numOutputs)
+        {
+            ports.audioOuts.setUnchecked(port, static_cast<float*> (data));
+            return;
+        }
+        port -= numOutputs;
+
+        if (port-- == 0)
+        {
+            ports.enabled = static_cast<const float*> (data);
+            return;
+        }
+
+        if (port-- == 0)
+        {
+            ports.reset = static_cast<const float*> (data);
+            return;
+        }
+
+       #if JucePlugin_LV2WantsFreeWheel
+        if (port-- == 0)
+        {
+            ports.freeWheel = static_cast<const float*> (data);
+            return;
+        }
+       #endif
+
+       #if JucePlugin_LV2WantsLatency
+        if (port-- == 0)
+        {
+            ports.latency = static_cast<float*> (data);
+            return;
+        }
+       #endif
+
+        if (numPrograms > 1 && port-- == 0)
+        {
+            ports.program = static_cast<const float*> (data);
+            return;
+        }
+
+        // NOTE bypass parameter is not part of the regular control ports
+        if (port < numControls - 1)
+        {
+            ports.controls.setUnchecked(port, static_cast<float*> (data));
+            return;
+        }
+        port -= numControls - 1;
+
+        if (port < numMeters)
+        {
+            ports.meters.setUnchecked(port, static_cast<float*> (data));
+            return;
+        }
+        // port -= numMeters;
+    }
+
+    int getNumAudioInputs() const noexcept
+    {
+        return numInputs;
+    }
+
+    int getNumAudioOutputs() const noexcept
+    {
+        return numOutputs;
+    }
+
+    AudioProcessor* getFilter() const noexcept
+    {
+        return filter.get();
+    }
+
+    void activate()
+    {
+       #if JucePlugin_LV2MemoryAccounting
+        memoryUsage.activate = {};
+        memoryUsage.run = {};
+        memoryUsage.numRuns = 0;
+        const ScopedMemoryAccounting sma (&memoryUsage.activate);
+       #endif
+
+        prepareFilter();
+
+        audioBuffers.calloc (std::max (numInputs, numOutputs));
+
+       #if JucePlugin_LV2FreeWheelBlockSize
+        freeWheelFifo.buffers.calloc (2 * std::max (numInputs, numOutputs) * kFreeWheelBlockSize);
+        freeWheelFifo.collect = 0;
+        freeWheelFifo.position = 0;
+       #endif
+
+        if (! smoothers.isEmpty())
+            rampBuffers.calloc (smoothers.size() * host.maxBufferSize * kOversamplingFactor);
+
+       #ifdef ENABLE_MOD_LICENSING_API
+        licenseRunCount = 0;
+       #endif
+
+       #if JucePlugin_LV2FreeWheelBlockSize
+        // handles re-preparing when leaving freewheel mode, see backgroundIdle
+        background->addClient (this);
+       #endif
+
+       #if JucePlugin_LV2OutputGuard
+        outputGuard->activate();
+       #endif
+
+       #if JucePlugin_LV2MemoryAccounting
+        lv2_log_note (&host.logger, "Memory usage on activate: %zu allocations, %zu bytes\n",
+                      memoryUsage.activate.numAllocations, memoryUsage.activate.numBytes);
+       #endif
+    }
+
+    void deactivate()
+    {
+       #if JucePlugin_LV2MemoryAccounting
+        if (memoryUsage.numRuns != 0)
+            lv2_log_note (&host.logger, "Memory usage on first %d runs: %zu allocations, %zu bytes\n",
+                          memoryUsage.numRuns, memoryUsage.run.numAllocations, memoryUsage.run.numBytes);
+       #endif
+
+       #if JucePlugin_LV2FreeWheelBlockSize
+        background->removeClient (this);
+
+        // drop any pending freewheel exit, the next activate prepares for realtime use directly
+        if (freeWheelExit.exchange (kFreeWheelExitNone) != kFreeWheelExitNone)
+        {
+            freeWheeling = false;
+            setNonRealtime (false);
+        }
+       #endif
+
+       #if JucePlugin_LV2OutputGuard
+        // waits for a reset already in progress, so it never overlaps releaseResources
+        outputGuard->deactivate();
+       #endif
+
+        audioBuffers.free();
+        rampBuffers.free();
+       #if JucePlugin_LV2FreeWheelBlockSize
+        freeWheelFifo.buffers.free();
+       #endif
+
+        filter->releaseResources();
+       #if JucePlugin_LV2DualMono
+        if (twin != nullptr)
+            twin->releaseResources();
+       #endif
+    }
+
+    void run(int sampleCount)
+    {
+       #if JucePlugin_LV2EnableTracing
+        tracer->push (Tracer::kEventRunBegin, Tracer::getTime(), 0, sampleCount);
+       #endif
+
+       #if JucePlugin_LV2MemoryAccounting
+        const ScopedMemoryAccounting sma (getRunMemoryCounters());
+       #endif
+
+       #if JucePlugin_LV2FreeWheelBlockSize
+        // the background thread is done re-preparing the filter for realtime use, stop accumulating blocks
+        if (freeWheelExit.load (std::memory_order_acquire) == kFreeWheelExitDone)
+        {
+            freeWheelExit.store (kFreeWheelExitNone, std::memory_order_relaxed);
+            freeWheeling = false;
+           #if JucePlugin_LV2Oversampling
+            resetOversampling();
+           #endif
+        }
+       #endif
+
+        if (ports.freeWheel != nullptr && freeWheeling != (*ports.freeWheel > 0.5f))
+        {
+           #if JucePlugin_LV2FreeWheelBlockSize
+            if (freeWheeling)
+            {
+                // Leaving freewheel mode happens in a realtime context, so re-preparing is left to the background thread.
+                // NOTE the background thread is not woken up here, as that is not realtime safe
+                int expected = kFreeWheelExitNone;
+                freeWheelExit.compare_exchange_strong (expected, kFreeWheelExitPending, std::memory_order_release);
+            }
+            else
+            {
+                // There are no realtime constraints while rendering offline, so we can afford to re-prepare the filter.
+                // This allows it to switch into a higher quality mode by checking isNonRealtime() in prepareToPlay.
+                freeWheeling = true;
+                setNonRealtime (true);
+                reprepareFilter();
+
+                const int numChannels = std::max (numInputs, numOutputs);
+                FloatVectorOperations::clear (freeWheelFifo.buffers, 2 * numChannels * kFreeWheelBlockSize);
+                freeWheelFifo.collect = 0;
+                freeWheelFifo.position = 0;
+               #if JucePlugin_LV2Oversampling
+                resetOversampling();
+               #endif
+            }
+           #else
+            freeWheeling = ! freeWheeling;
+            setNonRealtime (freeWheeling);
+           #if JucePlugin_LV2Oversampling
+            resetOversampling();
+           #endif
+           #endif
+        }
+
+       #if JucePlugin_LV2FreeWheelBlockSize
+        // The background thread re-prepares the filter while holding its callback lock,
+        // so output silence right away instead of waiting for it, and leave the filter untouched until it is done
+        if (freeWheelExit.load (std::memory_order_acquire) == kFreeWheelExitPending)
+        {
+            for (int i = 0; i < numOutputs; ++i)
+                FloatVectorOperations::clear (ports.audioOuts[i], sampleCount);
+
+           #if JucePlugin_LV2EnableTracing
+            tracer->push (Tracer::kEventRunEnd, Tracer::getTime());
+           #endif
+            return;
+        }
+       #endif
+
+        if (ports.reset != nullptr && *ports.reset > 0.5f)
+        {
+           #if JucePlugin_LV2EnableTracing
+            tracer->push (Tracer::kEventReset, Tracer::getTime());
+           #endif
+            filter->reset();
+           #if JucePlugin_LV2DualMono
+            if (twin != nullptr)
+                twin->reset();
+           #endif
+           #if JucePlugin_LV2Oversampling
+            resetOversampling();
+           #endif
+           #ifdef ENABLE_MOD_LICENSING_API
+            licenseRunCount = 0;
+           #endif
+        }
+
+        if (ports.latency != nullptr)
+        {
+            float latency = static_cast<float> (filter->getLatencySamples());
+
+           #if JucePlugin_LV2Oversampling
+            // filter latency is in oversampled samples
+            latency = latency / kOversamplingFactor + getOversampling().getLatencyInSamples();
+           #endif
+
+           #if JucePlugin_LV2FreeWheelBlockSize
+            if (freeWheeling)
+                latency += kFreeWheelBlockSize;
+           #endif
+
+            // latency port is lv2:integer
+            *ports.latency = std::round (latency);
+        }
+
+        if (sampleCount == 0)
+        {
+            // LV2 pre-roll
+            // Hosts might use this to force plugins to update its output control ports.
+            // (plugins can only access port locations during run)
+            publishMeters();
+
+           #if JucePlugin_LV2EnableTracing
+            tracer->push (Tracer::kEventRunEnd, Tracer::getTime());
+           #endif
+            return;
+        }
+
+        // Switch program at block boundary, using the snapshot taken during instantiate
+        if (ports.program != nullptr)
+        {
+            const int program = jlimit (0, numPrograms - 1, roundToInt (*ports.program));
+
+            if (program != lastProgram)
+            {
+                lastProgram = program;
+
+                const Array<AudioProcessorParameter*>& parameters = filter->getParameters();
+                const float* const values = programValues.begin() + program * numControls;
+
+                // NOTE lastControlValues is purposefully not touched,
+                // so that only control ports changed after this point override the program values
+                for (int i = 0; i < numControls; ++i)
+                {
+                    AudioProcessorParameter* const parameter = parameters.getUnchecked (i);
+
+                    if (parameter == bypassParameter)
+                        continue;
+
+                    setParameterValue (i, parameter, values[i]);
+
+                    // programs jump directly to the new value, so stop any ongoing ramp
+                    if (const int smootherIndex = smootherIndexes.getUnchecked (i); smootherIndex >= 0)
+                    {
+                        Smoother& smoother = smoothers.getReference (smootherIndex);
+                        smoother.current = smoother.target = getPlainValue (parameter, values[i]);
+                        smoother.remaining = 0;
+                    }
+                }
+            }
+        }
+
+        // Check for updated parameters
+        {
+            const Array<AudioProcessorParameter*>& parameters = filter->getParameters();
+            float value;
+
+            for (int i = 0, offset = 0; i < numControls; ++i)
+            {
+                AudioProcessorParameter* const parameter = parameters.getUnchecked (i);
+
+                if (parameter == bypassParameter)
+                {
+                    ++offset;
+                    if (ports.enabled == nullptr)
+                        continue;
+                    value = 1.f - *ports.enabled;
+                }
+                else
+                {
+                    if (ports.controls.getUnchecked(i - offset) == nullptr)
+                        continue;
+                    value = *ports.controls.getUnchecked(i - offset);
+                }
+
+                if (approximatelyEqual(lastControlValues.getUnchecked(i), value))
+                    continue;
+
+                lastControlValues.setUnchecked(i, value);
+
+               #if JucePlugin_LV2EnableTracing
+                tracer->push (Tracer::kEventParameterChange, Tracer::getTime(), 0, i, value);
+               #endif
+
+                // smoothed parameters start a new ramp from wherever they are now
+                if (const int smootherIndex = smootherIndexes.getUnchecked (i); smootherIndex >= 0)
+                {
+                    Smoother& smoother = smoothers.getReference (smootherIndex);
+                    smoother.target = value;
+                    smoother.increment = (value - smoother.current) / static_cast<float> (smoother.numSteps);
+                    smoother.remaining = smoother.numSteps;
+                    continue;
+                }
+
+                if (auto* rangedParameter = dynamic_cast<const RangedAudioParameter*> (parameter))
+                    value = rangedParameter->convertTo0to1 (value);
+
+                setParameterValue (i, parameter, value);
+            }
+        }
+
+        // Generate ramps for moving parameters, idle ones are skipped right away
+        for (int i = 0; i < smoothers.size(); ++i)
+        {
+            Smoother& smoother = smoothers.getReference (i);
+
+            if (smoother.remaining == 0)
+                continue;
+
+            const int numRampSamples = jmin (smoother.remaining, sampleCount);
+            smoother.remaining -= numRampSamples;
+
+            // ramp buffers are sized for the max block length, hosts breaking that bound just jump to the segment end
+            // the same applies to freewheel block accumulation, as the filter does not process audio at host run boundaries
+            // with oversampling, ramps are generated at the oversampled rate, as seen by processBlock
+           #if JucePlugin_LV2FreeWheelBlockSize
+            const bool canRamp = sampleCount <= host.maxBufferSize && ! freeWheeling;
+           #else
+            const bool canRamp = sampleCount <= host.maxBufferSize;
+           #endif
+
+            if (canRamp)
+            {
+                float* const ramp = rampBuffers + i * host.maxBufferSize * kOversamplingFactor;
+                const float start = smoother.current;
+                const float increment = smoother.increment / static_cast<float> (kOversamplingFactor);
+                const int numRampValues = numRampSamples * kOversamplingFactor;
+                const int numValues = sampleCount * kOversamplingFactor;
+
+                // simple enough for the compiler to vectorise
+                for (int j = 0; j < numRampValues; ++j)
+                    ramp[j] = start + increment * static_cast<float> (j + 1);
+
+                if (numRampValues < numValues)
+                    FloatVectorOperations::fill (ramp + numRampValues, smoother.target, numValues - numRampValues);
+
+                smoother.smoothing->setSmoothedValues (ramp);
+               #if JucePlugin_LV2DualMono
+                if (smoother.twinSmoothing != nullptr)
+                    smoother.twinSmoothing->setSmoothedValues (ramp);
+               #endif
+                smoother.moving = true;
+            }
+
+            smoother.current = smoother.remaining == 0
+                ? smoother.target
+                : smoother.current + smoother.increment * static_cast<float> (numRampSamples);
+
+            setParameterValue (smoother.index, smoother.parameter, getNormalisedValue (smoother.parameter, smoother.current));
+        }
+
+       #if JucePlugin_LV2FreeWheelBlockSize
+        if (freeWheeling)
+        {
+            runFreeWheel (sampleCount);
+            updateMeters (sampleCount);
+
+           #if JucePlugin_LV2EnableTracing
+            tracer->push (Tracer::kEventRunEnd, Tracer::getTime());
+           #endif
+            return;
+        }
+       #endif
+
+        // prepare audio buffers
+        {
+            int i;
+            for (i = 0; i < numOutputs; ++i)
+            {
+                audioBuffers[i] = ports.audioOuts[i];
+
+                if (i < numInputs && ports.audioIns[i] != ports.audioOuts[i])
+                    FloatVectorOperations::copy (ports.audioOuts[i], ports.audioIns[i], sampleCount);
+            }
+            for (; i < numInputs; ++i)
+                audioBuffers[i] = const_cast<float*>(ports.audioIns[i]);
+        }
+
+        processFilter (sampleCount);
+        updateMeters (sampleCount);
+
+       #if JucePlugin_LV2EnableTracing
+        tracer->push (Tracer::kEventRunEnd, Tracer::getTime());
+       #endif
+    }
+
+private:
+   #if JucePlugin_LV2MemoryAccounting
+    // returns the counters to use for the current run, or null once the first kMemoryAccountingRuns are done
+    // NOTE called from the audio thread, run usage is only reported on deactivate
+    MemoryCounters* getRunMemoryCounters() noexcept
+    {
+        if (memoryUsage.numRuns >= kMemoryAccountingRuns)
+            return nullptr;
+
+        ++memoryUsage.numRuns;
+        return &memoryUsage.run;
+    }
+   #endif
+
+    // Copy meter values into output ports at a decimated rate
+    void updateMeters (int sampleCount)
+    {
+        meterUpdateCounter += sampleCount;
+
+        if (meterUpdateCounter >= meterUpdateInterval)
+        {
+            meterUpdateCounter = 0;
+            publishMeters();
+        }
+    }
+
+    void publishMeters()
+    {
+        for (int i = 0; i < numMeters; ++i)
+        {
+            if (float* const port = ports.meters.getUnchecked (i))
+                *port = getMeterValue (i);
+        }
+    }
+
+    // meter value of the filter, combined with the one of its dual-mono twin
+    float getMeterValue (const int index) const noexcept
+    {
+        const float value = meters->getMeterValue (index);
+
+       #if JucePlugin_LV2DualMono
+        if (twinMeters != nullptr)
+        {
+            const float twinValue = twinMeters->getMeterValue (index);
+
+            switch (meters->getMeters().getReference (index).dualMono)
+            {
+            case anagram::AudioProcessorMeter::kDualMonoMaximum:
+                return std::max (value, twinValue);
+            case anagram::AudioProcessorMeter::kDualMonoMinimum:
+                return std::min (value, twinValue);
+            case anagram::AudioProcessorMeter::kDualMonoLeftOnly:
+                break;
+            }
+        }
+       #endif
+
+        return value;
+    }
+
+    // dispatch a normalised parameter value to the filter (and its dual-mono twin)
+    void setParameterValue (const int index, AudioProcessorParameter* const parameter, const float value)
+    {
+        parameter->setValueNotifyingHost (value);
+
+       #if JucePlugin_LV2DualMono
+        if (twin != nullptr)
+            twin->getParameters().getUnchecked (index)->setValueNotifyingHost (value);
+       #else
+        ignoreUnused (index);
+       #endif
+    }
+
+    void setNonRealtime (const bool nonRealtime) noexcept
+    {
+        filter->setNonRealtime (nonRealtime);
+       #if JucePlugin_LV2DualMono
+        if (twin != nullptr)
+            twin->setNonRealtime (nonRealtime);
+       #endif
+    }
+
+   #if JucePlugin_LV2FreeWheelBlockSize
+    void reprepareFilter()
+    {
+        const ScopedLock sl (filter->getCallbackLock());
+        filter->releaseResources();
+       #if JucePlugin_LV2DualMono
+        if (twin != nullptr)
+            twin->releaseResources();
+       #endif
+        prepareFilter();
+    }
+   #endif
+
+    void backgroundIdle() override
+    {
+       #if JucePlugin_LV2FreeWheelBlockSize
+        if (freeWheelExit.load (std::memory_order_acquire) != kFreeWheelExitPending)
+            return;
+
+        // NOTE freeWheeling is still set at this point, the audio thread only switches back to regular processing once done
+        {
+            const ScopedLock sl (filter->getCallbackLock());
+            setNonRealtime (false);
+            reprepareFilter();
+        }
+
+        freeWheelExit.store (kFreeWheelExitDone, std::memory_order_release);
+       #endif
+    }
+
+    void prepareFilter()
+    {
+        // run can be called with up to bufs:maxBlockLength samples, the nominal length is only the common case
+       #if JucePlugin_LV2FreeWheelBlockSize
+        const int blockSize = freeWheeling ? std::max (host.maxBufferSize, kFreeWheelBlockSize) : host.maxBufferSize;
+       #else
+        const int blockSize = host.maxBufferSize;
+       #endif
+
+       #if JucePlugin_LV2Oversampling
+        oversampling->initProcessing (static_cast<size_t> (blockSize));
+        if (freeWheelOversampling != nullptr)
+            freeWheelOversampling->initProcessing (static_cast<size_t> (blockSize));
+       #endif
+
+        // the filter always runs at the oversampled rate
+        const double filterSampleRate = host.sampleRate * kOversamplingFactor;
+        const int filterBlockSize = blockSize * kOversamplingFactor;
+
+       #if JucePlugin_LV2DualMono
+        if (twin != nullptr)
+        {
+            for (AudioProcessor* const f : { filter.get(), twin.get() })
+            {
+                f->prepareToPlay (filterSampleRate, filterBlockSize);
+                f->setPlayConfigDetails (numInputs / 2, numOutputs / 2, filterSampleRate, filterBlockSize);
+            }
+            return;
+        }
+       #endif
+
+        filter->prepareToPlay (filterSampleRate, filterBlockSize);
+        filter->setPlayConfigDetails (numInputs, numOutputs, filterSampleRate, filterBlockSize);
+    }
+
+   #if JucePlugin_LV2Oversampling
+    // quality goes from 0 (lowest latency) to 2 (best stopband attenuation), see OVERSAMPLING_QUALITY in CMake
+    std::unique_ptr<dsp::Oversampling<float>> createOversampling (const int quality) const
+    {
+        using Oversampling = dsp::Oversampling<float>;
+
+        const auto filterType = quality >= 2 ? Oversampling::filterHalfBandFIREquiripple
+                                             : Oversampling::filterHalfBandPolyphaseIIR;
+
+        return std::make_unique<Oversampling> (static_cast<size_t> (std::max (numInputs, numOutputs)),
+                                               static_cast<size_t> (roundToInt (std::log2 (kOversamplingFactor))),
+                                               filterType,
+                                               quality >= 1);
+    }
+
+    // higher quality is used while freewheeling, if available
+    dsp::Oversampling<float>& getOversampling() const noexcept
+    {
+        if (freeWheeling && freeWheelOversampling != nullptr)
+            return *freeWheelOversampling;
+
+        return *oversampling;
+    }
+
+    void resetOversampling() noexcept
+    {
+        oversampling->reset();
+        if (freeWheelOversampling != nullptr)
+            freeWheelOversampling->reset();
+    }
+   #endif
+
+    // run processBlock on the already setup audioBuffers
+    void processBlocks (int sampleCount)
+    {
+        const int numChannels = std::max (numInputs, numOutputs);
+        float* const* channels = audioBuffers;
+
+       #if JucePlugin_LV2Oversampling
+        dsp::Oversampling<float>& currentOversampling = getOversampling();
+        dsp::AudioBlock<float> block (audioBuffers, static_cast<size_t> (numChannels), static_cast<size_t> (sampleCount));
+        dsp::AudioBlock<float> oversampledBlock = currentOversampling.processSamplesUp (block);
+
+        for (int i = 0; i < numChannels; ++i)
+            oversampledChannels[i] = oversampledBlock.getChannelPointer (static_cast<size_t> (i));
+
+        channels = oversampledChannels;
+        sampleCount = static_cast<int> (oversampledBlock.getNumSamples());
+       #endif
+
+       #if JucePlugin_LV2DualMono
+        if (twin != nullptr)
+        {
+            AudioSampleBuffer left (channels, 1, sampleCount);
+            AudioSampleBuffer right (channels + 1, 1, sampleCount);
+
+            twinMidiEvents.clear();
+
+            const ScopedLock sl (twin->getCallbackLock());
+
+           #if JucePlugin_LV2DualMonoParallel
+            if (dualMonoThread != nullptr)
+            {
+                dualMonoThread->startProcessing (*twin, right, twinMidiEvents);
+                filter->processBlock (left, midiEvents);
+                dualMonoThread->waitForProcessing();
+            }
+            else
+           #endif
+            {
+                filter->processBlock (left, midiEvents);
+                twin->processBlock (right, twinMidiEvents);
+            }
+        }
+        else
+       #endif
+        {
+            AudioSampleBuffer chans (channels, numChannels, sampleCount);
+            filter->processBlock (chans, midiEvents);
+        }
+
+       #if JucePlugin_LV2Oversampling
+        currentOversampling.processSamplesDown (block);
+       #endif
+    }
+
+    // process audio in-place, audioBuffers must point to channels already containing the input audio
+    void processFilter (int sampleCount)
+    {
+        // TODO send MIDI events as needed
+        midiEvents.clear();
+
+       #ifdef ENABLE_MOD_LICENSING_API
+        licenseRunCount = mod_license_run_begin(licenseRunCount, (uint32_t)sampleCount);
+       #endif
+
+       #if JucePlugin_LV2OutputGuard
+        // The background thread resets the filter while holding its callback lock,
+        // so output silence right away instead of waiting for the reset to finish
+        if (outputGuard->isResetPending())
+        {
+            for (int i = 0; i < numOutputs; ++i)
+                FloatVectorOperations::clear (audioBuffers[i], sampleCount);
+
+           #if JucePlugin_LV2Oversampling
+            // the oversampling filters might hold non-finite state too
+            resetOversampling();
+           #endif
+        }
+        else
+       #endif
+        {
+           #if JucePlugin_LV2EnableTracing
+            const int64_t lockWaitStart = Tracer::getTime();
+           #endif
+
+            const ScopedLock sl (filter->getCallbackLock());
+
+           #if JucePlugin_LV2EnableTracing
+            tracer->push (Tracer::kEventLockWait, lockWaitStart, Tracer::getTime() - lockWaitStart);
+           #endif
+
+            if (filter->isSuspended())
+            {
+                for (int i = 0; i < numOutputs; ++i)
+                    FloatVectorOperations::clear (audioBuffers[i], sampleCount);
+            }
+            else
+            {
+               #if JucePlugin_LV2OutputGuard
+                const ScopedNoDenormals snd;
+               #endif
+                processBlocks (sampleCount);
+            }
+        }
+
+       #if JucePlugin_LV2OutputGuard
+        outputGuard->check (audioBuffers, numOutputs, sampleCount);
+       #endif
+
+        // ramps are only valid during processBlock
+        for (Smoother& smoother : smoothers)
+        {
+            if (smoother.moving)
+            {
+                smoother.smoothing->setSmoothedValues (nullptr);
+               #if JucePlugin_LV2DualMono
+                if (smoother.twinSmoothing != nullptr)
+                    smoother.twinSmoothing->setSmoothedValues (nullptr);
+               #endif
+                smoother.moving = false;
+            }
+        }
+
+       #ifdef ENABLE_MOD_LICENSING_API
+        for (int i = 0; i < numOutputs; ++i)
+            mod_license_run_silence(licenseRunCount, audioBuffers[i], (uint32_t)sampleCount, (uint32_t)i);
+       #endif
+    }
+
+   #if JucePlugin_LV2FreeWheelBlockSize
+    // Accumulate host runs into large blocks for higher throughput while rendering offline.
+    // Uses 2 sets of buffers: one collects the incoming audio while the other (already processed) is played back,
+    // roles are swapped each time a full block has been collected and processed in-place.
+    // This adds kFreeWheelBlockSize samples of latency, which is reported to the host.
+    void runFreeWheel (int sampleCount)
+    {
+        const int numChannels = std::max (numInputs, numOutputs);
+
+        for (int offset = 0; offset < sampleCount;)
+        {
+            const int numSamples = std::min (sampleCount - offset, kFreeWheelBlockSize - freeWheelFifo.position);
+            float* const collect = freeWheelFifo.buffers + freeWheelFifo.collect * numChannels * kFreeWheelBlockSize;
+            float* const playback = freeWheelFifo.buffers + (1 - freeWheelFifo.collect) * numChannels * kFreeWheelBlockSize;
+
+            // NOTE inputs first, host buffers might be shared between inputs and outputs
+            for (int i = 0; i < numInputs; ++i)
+                FloatVectorOperations::copy (collect + i * kFreeWheelBlockSize + freeWheelFifo.position,
+                                             ports.audioIns[i] + offset,
+                                             numSamples);
+
+            for (int i = 0; i < numOutputs; ++i)
+                FloatVectorOperations::copy (ports.audioOuts[i] + offset,
+                                             playback + i * kFreeWheelBlockSize + freeWheelFifo.position,
+                                             numSamples);
+
+            offset += numSamples;
+            freeWheelFifo.position += numSamples;
+
+            if (freeWheelFifo.position == kFreeWheelBlockSize)
+            {
+                for (int i = 0; i < numChannels; ++i)
+                    audioBuffers[i] = collect + i * kFreeWheelBlockSize;
+
+                processFilter (kFreeWheelBlockSize);
+
+                freeWheelFifo.collect = 1 - freeWheelFifo.collect;
+                freeWheelFifo.position = 0;
+            }
+        }
+    }
+   #endif
+
+    static float getPlainValue (const AudioProcessorParameter* const parameter, const float normalisedValue)
+    {
+        if (auto* rangedParameter = dynamic_cast<const RangedAudioParameter*> (parameter))
+            return rangedParameter->convertFrom0to1 (normalisedValue);
+
+        return normalisedValue;
+    }
+
+    static float getNormalisedValue (const AudioProcessorParameter* const parameter, const float plainValue)
+    {
+        if (auto* rangedParameter = dynamic_cast<const RangedAudioParameter*> (parameter))
+            return rangedParameter->convertTo0to1 (plainValue);
+
+        return plainValue;
+    }
+
+  #ifdef ENABLE_JUCE_GUI
+    ScopedJuceInitialiser_GUI scopedJuceInitialiser;
+   #if JUCE_LINUX || JUCE_BSD
+    SharedResourcePointer<detail::MessageThread> messageThread;
+   #endif
+  #endif
+
+    std::unique_ptr<AudioProcessor> filter;
+   #if JucePlugin_LV2DualMono
+    std::unique_ptr<AudioProcessor> twin; // right channel filter, if processing dual-mono with 2 instances
+   #if JucePlugin_LV2DualMonoParallel
+    std::unique_ptr<DualMonoThread> dualMonoThread; // null if processing serially
+   #endif
+   #endif
+    AudioProcessorParameter* bypassParameter = nullptr;
+    anagram::AudioProcessorWithMeters* meters = nullptr;
+   #if JucePlugin_LV2DualMono
+    anagram::AudioProcessorWithMeters* twinMeters = nullptr; // right channel filter meters, if using a twin
+   #endif
+    int numInputs = 0;
+    int numOutputs = 0;
+    int numControls = 0;
+    int numPrograms = 0;
+    int lastProgram = 0;
+    int numMeters = 0;
+    int meterUpdateInterval = 1;
+    int meterUpdateCounter = 0;
+    bool freeWheeling = false;
+   #if JucePlugin_LV2FreeWheelBlockSize
+    enum FreeWheelExit { kFreeWheelExitNone, kFreeWheelExitPending, kFreeWheelExitDone };
+    std::atomic<int> freeWheelExit { kFreeWheelExitNone };
+    SharedResourcePointer<BackgroundThread> background;
+   #endif
+   #ifdef ENABLE_MOD_LICENSING_API
+    uint32_t licenseRunCount = 0;
+   #endif
+   #if JucePlugin_LV2EnableTracing
+    std::unique_ptr<Tracer> tracer;
+   #endif
+   #if JucePlugin_LV2OutputGuard
+    std::unique_ptr<OutputGuard> outputGuard;
+   #endif
+
+    struct {
+        double sampleRate;
+        int32_t bufferSize;
+        int32_t maxBufferSize; // never smaller than bufferSize
+        LV2_Log_Logger logger;
+        LV2_URID_Map* uridMap;
+    } host{};
+
+    struct {
+        Array<const float*> audioIns;
+        Array<float*> audioOuts;
+        Array<float*> controls;
+        Array<float*> meters;
+        const float* enabled = nullptr;
+        const float* reset = nullptr;
+        const float* freeWheel = nullptr;
+        float* latency = nullptr;
+        const float* program = nullptr;
+    } ports;
+
+    HeapBlock<float*> audioBuffers;
+    MidiBuffer midiEvents;
+
+   #if JucePlugin_LV2Oversampling
+    static constexpr int kOversamplingFactor = JucePlugin_LV2Oversampling;
+
+    std::unique_ptr<dsp::Oversampling<float>> oversampling;
+    std::unique_ptr<dsp::Oversampling<float>> freeWheelOversampling; // max quality, null if not needed
+    float* oversampledChannels[2] {};
+   #else
+    static constexpr int kOversamplingFactor = 1;
+   #endif
+   #if JucePlugin_LV2DualMono
+    MidiBuffer twinMidiEvents;
+   #endif
+
+   #if JucePlugin_LV2FreeWheelBlockSize
+    static constexpr int kFreeWheelBlockSize = JucePlugin_LV2FreeWheelBlockSize;
+
+    struct {
+        HeapBlock<float> buffers; // 2 * numChannels * kFreeWheelBlockSize
+        int collect = 0;
+        int position = 0;
+    } freeWheelFifo;
+   #endif
+
+    Array<float> lastControlValues; // includes bypass/enabled
+    Array<float> programValues; // normalised, numPrograms * numControls
+
+    // linear ramp state of a smoothed parameter, in plain value range
+    struct Smoother {
+        int index = 0;
+        AudioProcessorParameter* parameter = nullptr;
+        anagram::AudioParameterWithSmoothing* smoothing = nullptr;
+       #if JucePlugin_LV2DualMono
+        anagram::AudioParameterWithSmoothing* twinSmoothing = nullptr;
+       #endif
+        int numSteps = 0;
+        int remaining = 0;
+        float current = 0.f;
+        float target = 0.f;
+        float increment = 0.f;
+        bool moving = false;
+    };
+
+    Array<Smoother> smoothers;
+    Array<int> smootherIndexes; // per control, -1 if not smoothed
+    HeapBlock<float> rampBuffers; // smoothers.size() * host.maxBufferSize * kOversamplingFactor
+};
+
+// Create a plugin wrapper instance, returns null on failure
+static std::unique_ptr<JuceLv2Wrapper> createWrapper (double sampleRate,
+                                                      int32_t bufferSize,
+                                                      int32_t maxBufferSize,
+                                                      LV2_Log_Logger& logger,
+                                                      LV2_URID_Map* uridMap)
+{
+   #if JucePlugin_LV2MemoryAccounting
+    MemoryCounters instantiateCounters;
+    std::unique_ptr<JuceLv2Wrapper> wrapper;
+    {
+        const ScopedMemoryAccounting sma (&instantiateCounters);
+        wrapper = std::make_unique<JuceLv2Wrapper> (sampleRate, bufferSize, maxBufferSize, logger, uridMap);
+    }
+    wrapper->memoryUsage.instantiate = instantiateCounters;
+
+    lv2_log_note (&logger, "Memory usage on instantiate: %zu allocations, %zu bytes\n",
+                  instantiateCounters.numAllocations, instantiateCounters.numBytes);
+   #else
+    std::unique_ptr<JuceLv2Wrapper> wrapper = std::make_unique<JuceLv2Wrapper> (sampleRate,
+                                                                                bufferSize,
+                                                                                maxBufferSize,
+                                                                                logger,
+                                                                                uridMap);
+   #endif
+
+    if (wrapper->ok)
+        return wrapper;
+
+    return {};
+}
+
+#if JucePlugin_LV2AsyncInstantiate
+// Name of the file written next to the plugin binary during recall, describing the port layout.
+// Contains "<numInputs> <numOutputs> <numPorts>", all port indexes from numInputs + numOutputs onwards are controls.
+static constexpr const char* const kAsyncLayoutFilename = "async-layout.txt";
+
+// Shared pool for creating the real wrappers of asynchronously instantiated plugins.
+// Separate from the background thread so that slow filter construction never delays its regular clients,
+// with multiple threads so that loading many plugins at once does not serialise behind the first one.
+struct AsyncLoader
+{
+    ThreadPool pool { std::max (1, SystemStats::getNumCpus() - 1) };
+};
+
+// Lightweight instance shell that returns from instantiate right away.
+// The real plugin wrapper is created (and activated, if needed) on the shared loader pool,
+// while this shell passes through dry audio. The real wrapper is swapped in at the next block boundary once ready.
+// Falls back to synchronous instantiation if the layout file is missing.
+class AsyncJuceLv2Wrapper : private ThreadPoolJob
+{
+public:
+    AsyncJuceLv2Wrapper (double sampleRate_, int32_t bufferSize_, int32_t maxBufferSize_,
+                         const LV2_Log_Logger& logger_, LV2_URID_Map* uridMap_,
+                         int numInputs_, int numOutputs_, int numPorts)
+        : ThreadPoolJob ("Anagram LV2 Loader"),
+          sampleRate (sampleRate_),
+          bufferSize (bufferSize_),
+          maxBufferSize (maxBufferSize_),
+          logger (logger_),
+          uridMap (uridMap_),
+          numInputs (numInputs_),
+          numOutputs (numOutputs_)
+    {
+        ports.insertMultiple (0, nullptr, numPorts);
+
+        queued = true;
+        loader->pool.addJob (this, false);
+    }
+
+    // synchronous variant, the wrapper is already created and ready
+    explicit AsyncJuceLv2Wrapper (std::unique_ptr<JuceLv2Wrapper> wrapper_)
+        : ThreadPoolJob ("Anagram LV2 Loader"),
+          wrapper (std::move (wrapper_)),
+          numInputs (wrapper->getNumAudioInputs()),
+          numOutputs (wrapper->getNumAudioOutputs())
+    {
+        ready.store (true, std::memory_order_release);
+        swapped = true;
+    }
+
+    ~AsyncJuceLv2Wrapper() override
+    {
+        // waits for the job to finish if already running
+        if (queued)
+            loader->pool.removeJob (this, false, -1);
+    }
+
+    void connect (const int port, void* const data)
+    {
+        if (swapped)
+        {
+            wrapper->connect (port, data);
+            return;
+        }
+
+        if (isPositiveAndBelow (port, ports.size()))
+            ports.setUnchecked (port, data);
+    }
+
+    void activate()
+    {
+        const ScopedLock sl (activationLock);
+        activated = true;
+
+        if (ready.load (std::memory_order_acquire))
+            wrapper->activate();
+    }
+
+    void deactivate()
+    {
+        const ScopedLock sl (activationLock);
+        activated = false;
+
+        if (ready.load (std::memory_order_acquire))
+            wrapper->deactivate();
+    }
+
+    void run (const int sampleCount)
+    {
+        if (! swapped && ready.load (std::memory_order_acquire))
+        {
+            for (int i = 0; i < ports.size(); ++i)
+                wrapper->connect (i, ports.getUnchecked (i));
+
+            swapped = true;
+        }
+
+        if (swapped)
+        {
+            wrapper->run (sampleCount);
+            return;
+        }
+
+        // dry passthrough while the real wrapper is not ready yet
+        for (int i = 0; i < numOutputs; ++i)
+        {
+            const auto* const input = static_cast<const float*> (ports.getUnchecked (std::min (i, numInputs - 1)));
+            auto* const output = static_cast<float*> (ports.getUnchecked (numInputs + i));
+
+            if (output == nullptr)
+                continue;
+
+            if (input == nullptr)
+                FloatVectorOperations::clear (output, sampleCount);
+            else if (input != output)
+                FloatVectorOperations::copy (output, input, sampleCount);
+        }
+    }
+
+    JuceLv2Wrapper* getWrapper() const noexcept
+    {
+        return ready.load (std::memory_order_acquire) ? wrapper.get() : nullptr;
+    }
+
+private:
+    JobStatus runJob() override
+    {
+        initialise();
+        return jobHasFinished;
+    }
+
+    void initialise()
+    {
+        std::unique_ptr<JuceLv2Wrapper> newWrapper = createWrapper (sampleRate, bufferSize, maxBufferSize, logger, uridMap);
+
+        // keep passing through dry audio forever if the plugin failed to initialise
+        if (newWrapper == nullptr)
+        {
+            lv2_log_error (&logger, "Asynchronous instantiation failed, plugin will stay in passthrough mode\n");
+            return;
+        }
+
+        // Stop here if the plugin layout does not match the one written during recall
+        if (newWrapper->getNumAudioInputs() != numInputs || newWrapper->getNumAudioOutputs() != numOutputs)
+        {
+            lv2_log_error (&logger, "Plugin IO does not match <%s>, plugin will stay in passthrough mode\n",
+                           kAsyncLayoutFilename);
+            return;
+        }
+
+        const ScopedLock sl (activationLock);
+        wrapper = std::move (newWrapper);
+
+        if (activated)
+            wrapper->activate();
+
+        ready.store (true, std::memory_order_release);
+    }
+
+    const double sampleRate = 0.0;
+    const int32_t bufferSize = 0;
+    const int32_t maxBufferSize = 0;
+    LV2_Log_Logger logger {};
+    LV2_URID_Map* const uridMap = nullptr;
+
+    std::unique_ptr<JuceLv2Wrapper> wrapper;
+    const int numInputs;
+    const int numOutputs;
+
+    Array<void*> ports; // pending port connections, forwarded to the real wrapper once swapped in
+    CriticalSection activationLock;
+    bool activated = false;
+    bool queued = false; // whether this was added to the loader pool
+    bool swapped = false; // only touched by the audio thread after construction
+    std::atomic<bool> ready { false };
+
+    SharedResourcePointer<AsyncLoader> loader;
+};
+
+using PluginInstance = AsyncJuceLv2Wrapper;
+#else
+using PluginInstance = JuceLv2Wrapper;
+#endif
+
+#ifdef ENABLE_HEADLESS_HOST
+// Minimal LV2 host used to run the plugin during recall, which happens at build time.
+// Goes through lv2_descriptor just like a real host would.
+class HeadlessHost
+{
+public:
+    // maxBufferSize_ is advertised as bufs:maxBlockLength, 0 for not advertising it
+    HeadlessHost (const double sampleRate_, const int32_t bufferSize_, const int32_t maxBufferSize_ = 0)
+        : sampleRate (sampleRate_),
+          bufferSize (bufferSize_),
+          maxBufferSize (maxBufferSize_)
+    {
+        uridMap.handle = this;
+        uridMap.map = [] (LV2_URID_Map_Handle handle, const char* uri) -> LV2_URID
+        {
+            return static_cast<HeadlessHost*> (handle)->map (uri);
+        };
+
+        options[0] = { LV2_OPTIONS_INSTANCE, 0, map (LV2_BUF_SIZE__nominalBlockLength),
+                       sizeof (int32_t), map (LV2_ATOM__Int), &bufferSize };
+        if (maxBufferSize != 0)
+            options[1] = { LV2_OPTIONS_INSTANCE, 0, map (LV2_BUF_SIZE__maxBlockLength),
+                           sizeof (int32_t), map (LV2_ATOM__Int), &maxBufferSize };
+
+        uridMapFeature = { LV2_URID__map, &uridMap };
+        optionsFeature = { LV2_OPTIONS__options, options };
+        features[0] = &uridMapFeature;
+        features[1] = &optionsFeature;
+        features[2] = nullptr;
+    }
+
+    ~HeadlessHost()
+    {
+        if (handle == nullptr)
+            return;
+
+        if (activated)
+            descriptor->deactivate (handle);
+
+        descriptor->cleanup (handle);
+    }
+
+    // NOTE uses an empty bundle path, so asynchronous instantiation falls back to synchronous
+    bool instantiate()
+    {
+        descriptor = lv2_descriptor (0);
+        handle = descriptor->instantiate (descriptor, sampleRate, "", features);
+
+        if (handle == nullptr)
+            return false;
+
+        JuceLv2Wrapper* const wrapper = getWrapper();
+        const int numInputs = wrapper->getNumAudioInputs();
+        const int numOutputs = wrapper->getNumAudioOutputs();
+
+        audioBuffers.setSize (numInputs + numOutputs, std::max (bufferSize, maxBufferSize));
+        audioBuffers.clear();
+
+        for (int i = 0; i < numInputs + numOutputs; ++i)
+            descriptor->connect_port (handle, static_cast<uint32_t> (i), audioBuffers.getWritePointer (i));
+
+        return true;
+    }
+
+    void activate()
+    {
+        descriptor->activate (handle);
+        activated = true;
+    }
+
+    void run (const int sampleCount)
+    {
+        descriptor->run (handle, static_cast<uint32_t> (sampleCount));
+    }
+
+    JuceLv2Wrapper* getWrapper() const noexcept
+    {
+       #if JucePlugin_LV2AsyncInstantiate
+        return static_cast<AsyncJuceLv2Wrapper*> (handle)->getWrapper();
+       #else
+        return static_cast<JuceLv2Wrapper*> (handle);
+       #endif
+    }
+
+    float* getAudioInput (const int index) noexcept
+    {
+        return audioBuffers.getWritePointer (index);
+    }
+
+    void connectPort (const int index, void* const data)
+    {
+        descriptor->connect_port (handle, static_cast<uint32_t> (index), data);
+    }
+
+private:
+    LV2_URID map (const char* const uri)
+    {
+        int index = uris.indexOf (uri);
+
+        if (index < 0)
+        {
+            index = uris.size();
+            uris.add (uri);
+        }
+
+        return static_cast<LV2_URID> (index + 1);
+    }
+
+    const double sampleRate;
+    int32_t bufferSize;
+    int32_t maxBufferSize;
+
+    StringArray uris;
+    LV2_URID_Map uridMap {};
+    LV2_Options_Option options[3] {};
+    LV2_Feature uridMapFeature {};
+    LV2_Feature optionsFeature {};
+    const LV2_Feature* features[3] {};
+
+    const LV2_Descriptor* descriptor = nullptr;
+    LV2_Handle handle = nullptr;
+    bool activated = false;
+
+    AudioSampleBuffer audioBuffers;
+};
+#endif
+
+#if JucePlugin_LV2MemoryBudget
+// Run the plugin through its lifecycle and check total allocated memory against the budget given in CMake
+static int checkMemoryBudget()
+{
+    HeadlessHost headlessHost (48000.0, 128);
+
+    if (! headlessHost.instantiate())
+    {
+        fprintf (stderr, "Failed to instantiate plugin for memory budget check\n");
+        return 1;
+    }
+
+    headlessHost.activate();
+
+    for (int i = 0; i < JuceLv2Wrapper::kMemoryAccountingRuns; ++i)
+        headlessHost.run (128);
+
+    const auto& memoryUsage = headlessHost.getWrapper()->memoryUsage;
+    const size_t numBytes = memoryUsage.instantiate.numBytes + memoryUsage.activate.numBytes + memoryUsage.run.numBytes;
+
+    std::cout << "instantiate " << memoryUsage.instantiate.numBytes << " bytes, "
+                 "activate " << memoryUsage.activate.numBytes << " bytes, "
+                 "runs " << memoryUsage.run.numBytes << " bytes, "
+                 "total " << numBytes << " of " << static_cast<size_t> (JucePlugin_LV2MemoryBudget) << " bytes...";
+
+    if (numBytes > static_cast<size_t> (JucePlugin_LV2MemoryBudget))
+    {
+        std::cout << "failed!" << std::endl;
+        fprintf (stderr, "Plugin exceeds its memory budget\n");
+        return 1;
+    }
+
+    return 0;
+}
+#endif
+
+#if JucePlugin_LV2Benchmark
+// Measure instantiate time and processing cost with a fixed workload.
+// Exported as extension data for the external runner in the `benchmark` directory,
+// timings are never checked as part of the plugin build.
+static int runBenchmark (double* const instantiateMicroseconds, double* const nanosecondsPerSample)
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int bufferSize = 128;
+    constexpr int numInstantiations = 5;
+    constexpr int numRounds = 3;
+    constexpr int numBlocks = static_cast<int> (sampleRate) * 10 / bufferSize;
+
+    // best of several instantiations, to filter out scheduling noise
+    double instantiateTime = std::numeric_limits<double>::max();
+
+    for (int i = 0; i < numInstantiations; ++i)
+    {
+        HeadlessHost headlessHost (sampleRate, bufferSize);
+
+        const int64 start = Time::getHighResolutionTicks();
+
+        if (! headlessHost.instantiate())
+        {
+            fprintf (stderr, "Failed to instantiate plugin for benchmark\n");
+            return 1;
+        }
+
+        instantiateTime = std::min (instantiateTime,
+                                    Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start));
+    }
+
+    HeadlessHost headlessHost (sampleRate, bufferSize);
+    headlessHost.instantiate();
+    headlessHost.activate();
+
+    // deterministic noise as input, so that results can be compared between runs
+    Random random (0x414e4147);
+    for (int c = 0; c < headlessHost.getWrapper()->getNumAudioInputs(); ++c)
+    {
+        float* const input = headlessHost.getAudioInput (c);
+
+        for (int i = 0; i < bufferSize; ++i)
+            input[i] = random.nextFloat() * 2.f - 1.f;
+    }
+
+    // warm up caches and lazy initialization
+    for (int i = 0; i < 16; ++i)
+        headlessHost.run (bufferSize);
+
+    double runTime = std::numeric_limits<double>::max();
+
+    for (int r = 0; r < numRounds; ++r)
+    {
+        const int64 start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numBlocks; ++i)
+            headlessHost.run (bufferSize);
+
+        runTime = std::min (runTime, Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start));
+    }
+
+    *instantiateMicroseconds = instantiateTime * 1e6;
+    *nanosecondsPerSample = runTime * 1e9 / (numBlocks * bufferSize);
+    return 0;
+}
+#endif
+
+#if JucePlugin_LV2StressTest
+// Drive the plugin with adversarial control port workloads, reporting worst-case run time and realtime violations.
+// A realtime violation is a run that exceeds its deadline or that allocates memory, only the latter fails the build.
+// Runs where free-wheel mode is active or toggled are excluded from violations, as re-preparing the filter is allowed.
+// Only allocations fail the check, timing is reported but not enforced since build machines are not realtime systems.
+static int runStressTest()
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int bufferSize = 128;
+    constexpr int maxBufferSize = bufferSize * 4;
+    constexpr int numRunsPerScenario = 4000;
+
+    enum Scenario {
+        kScenarioAllPortsChanging,
+        kScenarioResetAndFreeWheelToggles,
+        kScenarioTinyBlocks,
+        kScenarioDisconnectedPorts,
+        kScenarioRandomBlockSizes,
+        kScenarioCount
+    };
+
+    static constexpr const char* const scenarioNames[kScenarioCount] = {
+        "all ports changing every block",
+        "random reset and free-wheel toggles",
+        "sample count 0 and 1",
+        "randomly disconnected ports",
+        "random block sizes up to bufs:maxBlockLength",
+    };
+
+    // hosts can run blocks larger than the nominal length, up to the advertised maximum
+    HeadlessHost headlessHost (sampleRate, bufferSize, maxBufferSize);
+
+    if (! headlessHost.instantiate())
+    {
+        fprintf (stderr, "Failed to instantiate plugin for stress test\n");
+        return 1;
+    }
+
+    AudioProcessor* const filter = headlessHost.getWrapper()->getFilter();
+    const Array<AudioProcessorParameter*>& parameters = filter->getParameters();
+    AudioProcessorParameter* const bypassParameter = filter->getBypassParameter();
+    const auto* const meters = dynamic_cast<const anagram::AudioProcessorWithMeters*> (filter);
+    const int numInputs = headlessHost.getWrapper()->getNumAudioInputs();
+    const int numOutputs = headlessHost.getWrapper()->getNumAudioOutputs();
+    const int numPrograms = filter->getNumPrograms();
+    const int numMeters = meters != nullptr ? meters->getMeters().size() : 0;
+
+    // port layout, must match connect and doRecall
+    int portIndex = numInputs + numOutputs;
+    const int enabledPort = portIndex++;
+    const int resetPort = portIndex++;
+   #if JucePlugin_LV2WantsFreeWheel
+    const int freeWheelPort = portIndex++;
+   #else
+    const int freeWheelPort = -1;
+   #endif
+   #if JucePlugin_LV2WantsLatency
+    ++portIndex; // latency output
+   #endif
+    const int programPort = numPrograms > 1 ? portIndex++ : -1;
+    const int firstParameterPort = portIndex;
+    portIndex += parameters.size() - 1;
+    portIndex += numMeters; // meter outputs
+    const int numPorts = portIndex;
+
+    // parameter for each regular control port
+    Array<AudioProcessorParameter*> portParameters;
+    for (AudioProcessorParameter* const parameter : parameters)
+    {
+        if (parameter != bypassParameter)
+            portParameters.add (parameter);
+    }
+
+    HeapBlock<float> portValues (numPorts, true);
+    portValues[enabledPort] = 1.f;
+
+    for (int i = 0; i < portParameters.size(); ++i)
+    {
+        AudioProcessorParameter* const parameter = portParameters.getUnchecked (i);
+
+        if (auto* rangedParameter = dynamic_cast<const RangedAudioParameter*> (parameter))
+            portValues[firstParameterPort + i] = rangedParameter->convertFrom0to1 (parameter->getValue());
+        else
+            portValues[firstParameterPort + i] = parameter->getValue();
+    }
+
+    const auto connectControlPorts = [&] (Random* const random)
+    {
+        for (int i = numInputs + numOutputs; i < numPorts; ++i)
+        {
+            // audio ports are never optional, every other port is
+            const bool disconnect = random != nullptr && random->nextInt (4) == 0;
+            headlessHost.connectPort (i, disconnect ? nullptr : portValues + i);
+        }
+    };
+
+    const auto randomizeParameters = [&] (Random& random)
+    {
+        for (int i = 0; i < portParameters.size(); ++i)
+        {
+            AudioProcessorParameter* const parameter = portParameters.getUnchecked (i);
+            const float value = parameter->isDiscrete() || parameter->isBoolean()
+                ? std::round (random.nextFloat() * static_cast<float> (std::max (1, parameter->getNumSteps() - 1)))
+                    / static_cast<float> (std::max (1, parameter->getNumSteps() - 1))
+                : random.nextFloat();
+
+            if (auto* rangedParameter = dynamic_cast<const RangedAudioParameter*> (parameter))
+                portValues[firstParameterPort + i] = rangedParameter->convertFrom0to1 (value);
+            else
+                portValues[firstParameterPort + i] = value;
+        }
+
+        portValues[enabledPort] = random.nextInt (8) == 0 ? 0.f : 1.f;
+
+        if (programPort >= 0)
+            portValues[programPort] = static_cast<float> (random.nextInt (numPrograms));
+    };
+
+    connectControlPorts (nullptr);
+    headlessHost.activate();
+
+    Random inputRandom (0x414e4147);
+    for (int c = 0; c < numInputs; ++c)
+    {
+        float* const input = headlessHost.getAudioInput (c);
+
+        for (int i = 0; i < maxBufferSize; ++i)
+            input[i] = inputRandom.nextFloat() * 2.f - 1.f;
+    }
+
+    // warm up, also gets past the runs that the wrapper accounts memory for itself
+    for (int i = 0; i < 32; ++i)
+        headlessHost.run (bufferSize);
+
+    int numViolations = 0;
+
+    for (int scenario = 0; scenario < kScenarioCount; ++scenario)
+    {
+        Random random (0x414e4147 + scenario);
+        double worstRunTime = 0.0;
+        int numDeadlineMisses = 0;
+        int numAllocatingRuns = 0;
+
+        for (int r = 0; r < numRunsPerScenario; ++r)
+        {
+            int sampleCount = bufferSize;
+            const bool wasFreeWheeling = freeWheelPort >= 0 && portValues[freeWheelPort] > 0.5f;
+
+            portValues[resetPort] = 0.f;
+
+            switch (scenario)
+            {
+            case kScenarioAllPortsChanging:
+                randomizeParameters (random);
+                break;
+            case kScenarioResetAndFreeWheelToggles:
+                if (random.nextInt (10) == 0)
+                    portValues[resetPort] = 1.f;
+                if (freeWheelPort >= 0 && random.nextInt (20) == 0)
+                    portValues[freeWheelPort] = wasFreeWheeling ? 0.f : 1.f;
+                break;
+            case kScenarioTinyBlocks:
+                randomizeParameters (random);
+                sampleCount = random.nextInt (2);
+                break;
+            case kScenarioDisconnectedPorts:
+                randomizeParameters (random);
+                connectControlPorts (&random);
+                break;
+            case kScenarioRandomBlockSizes:
+                if (random.nextBool())
+                    randomizeParameters (random);
+                sampleCount = random.nextInt (maxBufferSize + 1);
+                break;
+            }
+
+            const bool isFreeWheeling = freeWheelPort >= 0 && portValues[freeWheelPort] > 0.5f;
+
+            MemoryCounters runCounters;
+            const int64 start = Time::getHighResolutionTicks();
             {
-                filter->processBlock (chans, midiEvents);
+                const ScopedMemoryAccounting sma (&runCounters);
+                headlessHost.run (sampleCount);
             }
 
-           #ifdef ENABLE_MOD_LICENSING_API
-            for (int i = 0; i < numOutputs; ++i)
-                mod_license_run_silence(licenseRunCount, ports.audioOuts[i], (uint32_t)sampleCount, (uint32_t)i);
-           #endif
+            const double runTime = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+
+            if (wasFreeWheeling || isFreeWheeling)
+                continue;
+
+            worstRunTime = std::max (worstRunTime, runTime);
+
+            if (sampleCount != 0 && runTime > sampleCount / sampleRate)
+                ++numDeadlineMisses;
+
+            if (runCounters.numAllocations != 0)
+                ++numAllocatingRuns;
         }
-    }
 
-private:
-  #ifdef ENABLE_JUCE_GUI
-    ScopedJuceInitialiser_GUI scopedJuceInitialiser;
-   #if JUCE_LINUX || JUCE_BSD
-    SharedResourcePointer<detail::MessageThread> messageThread;
-   #endif
-  #endif
+        // restore a sane state for the next scenario
+        connectControlPorts (nullptr);
+        if (freeWheelPort >= 0)
+            portValues[freeWheelPort] = 0.f;
+        headlessHost.run (bufferSize);
 
-    std::unique_ptr<AudioProcessor> filter;
-    AudioProcessorParameter* bypassParameter = nullptr;
-    int numInputs = 0;
-    int numOutputs = 0;
-    int numControls = 0;
-   #ifdef ENABLE_MOD_LICENSING_API
-    uint32_t licenseRunCount = 0;
-   #endif
+        std::cout << "\n    " << scenarioNames[scenario] << ": worst run "
+                  << String (worstRunTime * 1e6, 1) << " us (block is "
+                  << String (bufferSize / sampleRate * 1e6, 1) << " us), "
+                  << numDeadlineMisses << " deadline misses, "
+                  << numAllocatingRuns << " allocating runs";
 
-    struct {
-        double sampleRate;
-        int32_t bufferSize;
-        LV2_Log_Logger logger;
-        LV2_URID_Map* uridMap;
-    } host{};
+        numViolations += numAllocatingRuns;
+    }
 
-    struct {
-        Array<const float*> audioIns;
-        Array<float*> audioOuts;
-        Array<float*> controls;
-        const float* enabled = nullptr;
-        const float* reset = nullptr;
-        const float* freeWheel = nullptr;
-        float* latency = nullptr;
-    } ports;
+    std::cout << "\n";
 
-    HeapBlock<float*> audioBuffers;
-    MidiBuffer midiEvents;
-    Array<float> lastControlValues; // includes bypass/enabled
-};
+    if (numViolations != 0)
+    {
+        fprintf (stderr, "Plugin allocates memory during run\n");
+        return 1;
+    }
+
+    return 0;
+}
+#endif
 
 static int doRecall(const char* libraryPath)
 {
@@ -393,13 +2501,22 @@ static int doRecall(const char* libraryPath)
    #endif
     filter->refreshParameterList();
 
+   #if JucePlugin_LV2DualMono
+    const int numFilters = setupDualMono (*filter) ? 2 : 1;
+   #else
+    constexpr int numFilters = 1;
+   #endif
+
     const Array<AudioProcessorParameter*>& parameters = filter->getParameters();
-    const int numInputs = filter->getTotalNumInputChannels();
-    const int numOutputs = filter->getTotalNumOutputChannels();
+    const int numInputs = filter->getTotalNumInputChannels() * numFilters;
+    const int numOutputs = filter->getTotalNumOutputChannels() * numFilters;
     const int numControls = parameters.size();
+    const int numPrograms = filter->getNumPrograms();
 
     AudioProcessorParameter* const bypassParameter = filter->getBypassParameter();
 
+    const auto* const meters = dynamic_cast<const anagram::AudioProcessorWithMeters*> (filter.get());
+
     // Stop here if filter has Anagram incompatible IO
     if (numInputs < 1 || numOutputs < 1 || numInputs > 2 || numOutputs > 2)
     {
@@ -421,6 +2538,57 @@ static int doRecall(const char* libraryPath)
         return 1;
     }
 
+    // Stop here if any port symbols clash, as that makes the ttl invalid
+    // NOTE port order must match the one used when writing dsp.ttl below, as fallback symbols depend on it
+    {
+        StringArray symbols;
+
+        const auto addSymbol = [&symbols] (const String& symbol) -> bool
+        {
+            if (symbols.contains (symbol))
+            {
+                fprintf (stderr, "Plugin port symbol \"%s\" is used more than once\n", symbol.toRawUTF8());
+                return false;
+            }
+
+            symbols.add (symbol);
+            return true;
+        };
+
+        for (int i = 0; i < numInputs; ++i)
+            addSymbol (numInputs == 1 ? String ("lv2_audio_in") : "lv2_audio_in_" + String (i + 1));
+
+        for (int i = 0; i < numOutputs; ++i)
+            addSymbol (numOutputs == 1 ? String ("lv2_audio_out") : "lv2_audio_out_" + String (i + 1));
+
+        addSymbol ("lv2_enabled");
+        addSymbol ("lv2_reset");
+       #if JucePlugin_LV2WantsFreeWheel
+        addSymbol ("lv2_freeWheeling");
+       #endif
+       #if JucePlugin_LV2WantsLatency
+        addSymbol ("lv2_latency");
+       #endif
+        if (numPrograms > 1)
+            addSymbol ("lv2_program");
+
+        for (int i = 0; i < numControls; ++i)
+        {
+            AudioProcessorParameter* const parameter = parameters.getUnchecked (i);
+
+            if (parameter != bypassParameter && ! addSymbol (getParameterSymbol (parameter, i)))
+                return 1;
+        }
+
+        if (meters != nullptr)
+        {
+            // symbols.size() is the index of the port being added
+            for (const anagram::AudioProcessorMeter& meter : meters->getMeters())
+                if (! addSymbol (sanitiseStringAsSymbol (meter.symbol, symbols.size())))
+                    return 1;
+        }
+    }
+
     const String libraryPathString { CharPointer_UTF8 { libraryPath } };
 
     const File libraryPathAbsolute = File::isAbsolutePath (libraryPathString)
@@ -453,10 +2621,80 @@ static int doRecall(const char* libraryPath)
                "\trdfs:seeAlso <dsp.ttl> .\n"
               #endif
                "\n";
+
+        // Presets, one per plugin program
+        if (numPrograms > 1)
+        {
+            for (int p = 0; p < numPrograms; ++p)
+            {
+                String name = filter->getProgramName (p);
+                if (name.isEmpty())
+                    name = "Program " + String(p + 1);
+
+                ttl << "<" JucePlugin_LV2URI "#preset" << std::to_string(p + 1) << ">\n"
+                       "\ta pset:Preset ;\n"
+                       "\tlv2:appliesTo <" JucePlugin_LV2URI "> ;\n"
+                       "\trdfs:label \"" << name.replace("\"", "'").toRawUTF8() << "\" ;\n"
+                       "\trdfs:seeAlso <presets.ttl> .\n"
+                       "\n";
+            }
+        }
     }
 
     std::cout << "done!" << std::endl;
 
+    //=================================================================================================================
+    // Create the presets.ttl file contents
+
+    if (numPrograms > 1)
+    {
+        std::cout << "Writing presets.ttl...";
+        std::cout.flush();
+
+        std::fstream ttl (libraryPathAbsolute.getSiblingFile ("presets.ttl").getFullPathName().toRawUTF8(),
+                          std::ios::out);
+
+        // Header
+        ttl << "@prefix lv2:  <" LV2_CORE_PREFIX "> .\n"
+               "@prefix pset: <" LV2_PRESETS_PREFIX "> .\n"
+               "\n";
+
+        const Array<float> programValues = getAllProgramValues (*filter);
+
+        for (int p = 0; p < numPrograms; ++p)
+        {
+            ttl << "<" JucePlugin_LV2URI "#preset" << std::to_string(p + 1) << ">\n"
+                   "\tlv2:port [\n";
+
+            bool first = true;
+            for (int i = 0; i < numControls; ++i)
+            {
+                AudioProcessorParameter* const parameter = parameters.getUnchecked(i);
+
+                if (parameter == bypassParameter)
+                    continue;
+
+                float value = programValues.getUnchecked (p * numControls + i);
+
+                if (auto* rangedParameter = dynamic_cast<const RangedAudioParameter*> (parameter))
+                    value = rangedParameter->convertFrom0to1 (value);
+
+                if (first)
+                    first = false;
+                else
+                    ttl << "\t] , [\n";
+
+                ttl << "\t\tlv2:symbol \"" << getParameterSymbol (parameter, i).toRawUTF8() << "\" ;\n"
+                       "\t\tpset:value " << std::to_string (value) << " ;\n";
+            }
+
+            ttl << "\t] .\n"
+                   "\n";
+        }
+
+        std::cout << "done!" << std::endl;
+    }
+
     //=================================================================================================================
     // Create the dsp.ttl file contents
 
@@ -497,6 +2735,7 @@ static int doRecall(const char* libraryPath)
                "\n"
                "\tlv2:requiredFeature bufs:boundedBlockLength , opts:options , urid:map ;\n"
                "\topts:requiredOption bufs:nominalBlockLength ;\n"
+               "\topts:supportedOption bufs:maxBlockLength ;\n"
               #ifdef ENABLE_MOD_LICENSING_API
                "\tlv2:extensionData <http://moddevices.com/ns/ext/license#interface> ;\n"
                "\tlv2:requiredFeature <http://moddevices.com/ns/ext/license#feature> ;\n"
@@ -613,6 +2852,36 @@ static int doRecall(const char* libraryPath)
                "\t\tunits:unit units:frame ;\n";
        #endif
 
+        // Program parameter
+        if (numPrograms > 1)
+        {
+            ttl << "\t] , [\n"
+                   "\t\ta lv2:InputPort , lv2:ControlPort ;\n"
+                   "\t\tlv2:index " << std::to_string(portIndex++) << " ;\n"
+                   "\t\tlv2:symbol \"lv2_program\" ;\n"
+                   "\t\tlv2:name \"Program\" ;\n"
+                   "\t\tlv2:default " << std::to_string(filter->getCurrentProgram()) << " ;\n"
+                   "\t\tlv2:minimum 0 ;\n"
+                   "\t\tlv2:maximum " << std::to_string(numPrograms - 1) << " ;\n"
+                   "\t\tlv2:portProperty lv2:integer , lv2:enumeration , lv2:connectionOptional , pprop:notOnGUI ;\n"
+                   "\t\tlv2:scalePoint [\n";
+
+            for (int p = 0; p < numPrograms; ++p)
+            {
+                String name = filter->getProgramName (p);
+                if (name.isEmpty())
+                    name = "Program " + String(p + 1);
+
+                if (p != 0)
+                    ttl << "\t\t] , [\n";
+
+                ttl << "\t\t\trdfs:label \"" << name.replace("\"", "'").toRawUTF8() << "\" ;\n"
+                       "\t\t\trdf:value " << std::to_string(p) << " ;\n";
+            }
+
+            ttl << "\t\t] ;\n";
+        }
+
         // regular parameters
         for (int i = 0, offset = 0; i < numControls; ++i)
         {
@@ -624,8 +2893,7 @@ static int doRecall(const char* libraryPath)
                 continue;
             }
 
-            const String symbol = sanitiseStringAsSymbol (
-                URL::addEscapeChars (LegacyAudioParameter::getParamID (parameter, false), true), i);
+            const String symbol = getParameterSymbol (parameter, i);
 
             // TODO ask Jesse the real param size
             String name = parameter->getName(32);
@@ -712,8 +2980,43 @@ static int doRecall(const char* libraryPath)
             }
         }
 
+        // meters
+        if (meters != nullptr)
+        {
+            for (const auto [counter, meter] : enumerate (meters->getMeters()))
+            {
+                String name = meter.name;
+                if (name.isEmpty())
+                    name = "Meter " + String(counter + 1);
+
+                ttl << "\t] , [\n"
+                       "\t\ta lv2:OutputPort , lv2:ControlPort ;\n"
+                       "\t\tlv2:index " << std::to_string(portIndex) << " ;\n"
+                       "\t\tlv2:symbol \"" << sanitiseStringAsSymbol (meter.symbol, portIndex).toRawUTF8() << "\" ;\n"
+                       "\t\tlv2:name \"" << name.replace("\"", "'").toRawUTF8() << "\" ;\n"
+                       "\t\tlv2:minimum " << std::to_string (meter.minimum) << " ;\n"
+                       "\t\tlv2:maximum " << std::to_string (meter.maximum) << " ;\n"
+                       "\t\tlv2:portProperty lv2:connectionOptional ;\n";
+
+                if (meter.label == "dB")
+                    ttl << "\t\tunits:unit units:db ;\n";
+
+                ++portIndex;
+            }
+        }
+
         ttl << "\t] ;\n\n";
 
+       #if JucePlugin_LV2AsyncInstantiate
+        // port layout for the asynchronous instantiation shell, see AsyncJuceLv2Wrapper
+        {
+            std::fstream layout (libraryPathAbsolute.getSiblingFile (kAsyncLayoutFilename).getFullPathName().toRawUTF8(),
+                                 std::ios::out);
+
+            layout << numInputs << " " << numOutputs << " " << portIndex << "\n";
+        }
+       #endif
+
         ttl << "\tdoap:name \"" << filter->getName().replace("\"", "'").toRawUTF8() << "\" ;\n"
                "\tdoap:description \"" JucePlugin_Desc << "\" ;\n"
                "\tdoap:maintainer [\n"
@@ -759,6 +3062,32 @@ static int doRecall(const char* libraryPath)
 
     std::cout << "done!" << std::endl;
 
+   #if JucePlugin_LV2MemoryBudget
+    //=================================================================================================================
+    // Verify the plugin stays within its memory budget
+
+    std::cout << "Checking memory budget...";
+    std::cout.flush();
+
+    if (checkMemoryBudget() != 0)
+        return 1;
+
+    std::cout << "done!" << std::endl;
+   #endif
+
+   #if JucePlugin_LV2StressTest
+    //=================================================================================================================
+    // Check plugin behaviour under adversarial control port workloads
+
+    std::cout << "Running stress test...";
+    std::cout.flush();
+
+    if (runStressTest() != 0)
+        return 1;
+
+    std::cout << "done!" << std::endl;
+   #endif
+
     return 0;
 }
 
@@ -769,7 +3098,7 @@ LV2_SYMBOL_EXPORT const LV2_Descriptor* lv2_descriptor (uint32_t index)
         JucePlugin_LV2URI,
         [] (const LV2_Descriptor*,
             double sampleRate,
-            const char*,
+            const char* bundlePath,
             const LV2_Feature* const* features) -> LV2_Handle
         {
             // query optional and required LV2 features
@@ -790,16 +3119,21 @@ LV2_SYMBOL_EXPORT const LV2_Descriptor* lv2_descriptor (uint32_t index)
                 return nullptr;
             }
 
-            // query buffer size from LV2 options
+            // query buffer sizes from LV2 options
+            const LV2_URID uridAtomInt = uridMap->map (uridMap->handle, LV2_ATOM__Int);
+            const LV2_URID uridMaxBlockLength = uridMap->map (uridMap->handle, LV2_BUF_SIZE__maxBlockLength);
+            const LV2_URID uridNominalBlockLength = uridMap->map (uridMap->handle, LV2_BUF_SIZE__nominalBlockLength);
             int32_t bufferSize = 0;
+            int32_t maxBufferSize = 0;
             for (int i = 0; options[i].key != 0 && options[i].type != 0; ++i)
             {
-                if (options[i].key == uridMap->map (uridMap->handle, LV2_BUF_SIZE__nominalBlockLength) &&
-                    options[i].type == uridMap->map (uridMap->handle, LV2_ATOM__Int))
-                {
+                if (options[i].type != uridAtomInt)
+                    continue;
+
+                if (options[i].key == uridNominalBlockLength)
                     bufferSize = *static_cast<const int32_t*> (options[i].value);
-                    break;
-                }
+                else if (options[i].key == uridMaxBlockLength)
+                    maxBufferSize = *static_cast<const int32_t*> (options[i].value);
             }
 
             if (bufferSize == 0)
@@ -808,6 +3142,9 @@ LV2_SYMBOL_EXPORT const LV2_Descriptor* lv2_descriptor (uint32_t index)
                 return nullptr;
             }
 
+            // max block length is optional, assume hosts not advertising it stick to the nominal length
+            maxBufferSize = std::max (bufferSize, maxBufferSize);
+
           #ifdef ENABLE_MOD_LICENSING_API
            #if JucePlugin_LV2IsSystemBlock
             mod_license_check(features, "urn:darkglass:pablito");
@@ -816,37 +3153,59 @@ LV2_SYMBOL_EXPORT const LV2_Descriptor* lv2_descriptor (uint32_t index)
            #endif
           #endif
 
-            std::unique_ptr<JuceLv2Wrapper> wrapper = std::make_unique<JuceLv2Wrapper> (sampleRate,
-                                                                                        bufferSize,
-                                                                                        logger,
-                                                                                        uridMap);
+           #if JucePlugin_LV2AsyncInstantiate
+            // use the port layout written during recall to setup a lightweight shell, if available
+            {
+                const StringArray layout = StringArray::fromTokens (
+                    File (CharPointer_UTF8 (bundlePath)).getChildFile (kAsyncLayoutFilename).loadFileAsString(), false);
 
-            if (wrapper->ok)
-                return wrapper.release();
+                if (layout.size() == 3)
+                {
+                    const int numInputs = layout[0].getIntValue();
+                    const int numOutputs = layout[1].getIntValue();
+                    const int numPorts = layout[2].getIntValue();
 
-            return nullptr;
+                    if (numInputs >= 1 && numOutputs >= 1 && numPorts > numInputs + numOutputs)
+                        return new AsyncJuceLv2Wrapper (sampleRate, bufferSize, maxBufferSize, logger, uridMap,
+                                                        numInputs, numOutputs, numPorts);
+                }
+            }
+           #else
+            ignoreUnused (bundlePath);
+           #endif
+
+            std::unique_ptr<JuceLv2Wrapper> wrapper = createWrapper (sampleRate, bufferSize, maxBufferSize, logger, uridMap);
+
+            if (wrapper == nullptr)
+                return nullptr;
+
+           #if JucePlugin_LV2AsyncInstantiate
+            return new AsyncJuceLv2Wrapper (std::move (wrapper));
+           #else
+            return wrapper.release();
+           #endif
         },
         [] (LV2_Handle instance, uint32_t port, void* data)
         {
-            static_cast<JuceLv2Wrapper*> (instance)->connect(static_cast<int> (port), data);
+            static_cast<PluginInstance*> (instance)->connect(static_cast<int> (port), data);
         },
         [] (LV2_Handle instance)
         {
-            static_cast<JuceLv2Wrapper*> (instance)->activate();
+            static_cast<PluginInstance*> (instance)->activate();
         },
         [] (LV2_Handle instance, uint32_t sampleCount)
         {
-            static_cast<JuceLv2Wrapper*> (instance)->run(static_cast<int> (sampleCount));
+            static_cast<PluginInstance*> (instance)->run(static_cast<int> (sampleCount));
         },
         [] (LV2_Handle instance)
         {
-            static_cast<JuceLv2Wrapper*> (instance)->deactivate();
+            static_cast<PluginInstance*> (instance)->deactivate();
         },
         [] (LV2_Handle instance)
         {
             JUCE_AUTORELEASEPOOL
             {
-                delete static_cast<JuceLv2Wrapper*> (instance);
+                delete static_cast<PluginInstance*> (instance);
             }
         },
         [] (const char* uri) -> const void*
@@ -863,6 +3222,23 @@ LV2_SYMBOL_EXPORT const LV2_Descriptor* lv2_descriptor (uint32_t index)
             if (std::strcmp(uri, "https://lv2-extensions.juce.com/turtle_recall") == 0)
                 return &recall;
 
+           #if JucePlugin_LV2Benchmark
+            // NOTE keep in sync with benchmark/anagram-lv2-benchmark.cpp
+            static const struct {
+                const char* juceVersion;
+                int (*run) (double*, double*);
+            } benchmark {
+                JUCE_STRINGIFY (JUCE_MAJOR_VERSION) "." JUCE_STRINGIFY (JUCE_MINOR_VERSION) "." JUCE_STRINGIFY (JUCE_BUILDNUMBER),
+                [] (double* instantiateMicroseconds, double* nanosecondsPerSample) -> int
+                {
+                    return runBenchmark (instantiateMicroseconds, nanosecondsPerSample);
+                }
+            };
+
+            if (std::strcmp(uri, "http://www.darkglass.com/lv2/ns#benchmark") == 0)
+                return &benchmark;
+           #endif
+
            #ifdef ENABLE_MOD_LICENSING_API
             return mod_license_interface(uri);
            #else
@@ -875,3 +3251,150 @@ LV2_SYMBOL_EXPORT const LV2_Descriptor* lv2_descriptor (uint32_t index)
 }
 
 }
+
+#if JucePlugin_LV2MemoryAccounting
+// Allocation hooks
+// Everything linked into the plugin binary has its allocations redirected here through `-Wl,--wrap=...`,
+// and operator new is replaced (hidden, so only for this binary) to go through the same hooks.
+// NOTE keep the wrapped symbols in sync with the `--wrap` link options in CMakeLists.txt
+extern "C" {
+
+void* __real_malloc (size_t);
+void* __real_calloc (size_t, size_t);
+void* __real_realloc (void*, size_t);
+int __real_posix_memalign (void**, size_t, size_t);
+void* __real_aligned_alloc (size_t, size_t);
+void* __real_memalign (size_t, size_t);
+
+__attribute__ ((visibility ("hidden"))) void* __wrap_malloc (const size_t size)
+{
+    juce::anagram_lv2_client::countAllocation (size);
+    return __real_malloc (size);
+}
+
+__attribute__ ((visibility ("hidden"))) void* __wrap_calloc (const size_t count, const size_t size)
+{
+    juce::anagram_lv2_client::countAllocation (count * size);
+    return __real_calloc (count, size);
+}
+
+// only growth is counted as bytes, based on the usable size of the old block (which can be slightly larger than requested)
+__attribute__ ((visibility ("hidden"))) void* __wrap_realloc (void* const ptr, const size_t size)
+{
+    const size_t oldSize = ptr != nullptr ? malloc_usable_size (ptr) : 0;
+    juce::anagram_lv2_client::countAllocation (size > oldSize ? size - oldSize : 0);
+    return __real_realloc (ptr, size);
+}
+
+__attribute__ ((visibility ("hidden"))) int __wrap_posix_memalign (void** const ptr, const size_t alignment, const size_t size)
+{
+    juce::anagram_lv2_client::countAllocation (size);
+    return __real_posix_memalign (ptr, alignment, size);
+}
+
+__attribute__ ((visibility ("hidden"))) void* __wrap_aligned_alloc (const size_t alignment, const size_t size)
+{
+    juce::anagram_lv2_client::countAllocation (size);
+    return __real_aligned_alloc (alignment, size);
+}
+
+__attribute__ ((visibility ("hidden"))) void* __wrap_memalign (const size_t alignment, const size_t size)
+{
+    juce::anagram_lv2_client::countAllocation (size);
+    return __real_memalign (alignment, size);
+}
+
+}
+
+__attribute__ ((visibility ("hidden"))) void* operator new (const size_t size)
+{
+    if (void* const ptr = std::malloc (size))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+__attribute__ ((visibility ("hidden"))) void* operator new[] (const size_t size)
+{
+    return operator new (size);
+}
+
+__attribute__ ((visibility ("hidden"))) void* operator new (const size_t size, const std::nothrow_t&) noexcept
+{
+    return std::malloc (size);
+}
+
+__attribute__ ((visibility ("hidden"))) void* operator new[] (const size_t size, const std::nothrow_t&) noexcept
+{
+    return std::malloc (size);
+}
+
+__attribute__ ((visibility ("hidden"))) void operator delete (void* const ptr) noexcept
+{
+    std::free (ptr);
+}
+
+__attribute__ ((visibility ("hidden"))) void operator delete[] (void* const ptr) noexcept
+{
+    std::free (ptr);
+}
+
+__attribute__ ((visibility ("hidden"))) void operator delete (void* const ptr, size_t) noexcept
+{
+    std::free (ptr);
+}
+
+__attribute__ ((visibility ("hidden"))) void operator delete[] (void* const ptr, size_t) noexcept
+{
+    std::free (ptr);
+}
+
+__attribute__ ((visibility ("hidden"))) void* operator new (const size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    void* ptr = nullptr;
+
+    // posix_memalign requires at least pointer alignment
+    if (posix_memalign (&ptr, std::max (static_cast<size_t> (alignment), sizeof (void*)), size) != 0)
+        return nullptr;
+
+    return ptr;
+}
+
+__attribute__ ((visibility ("hidden"))) void* operator new[] (const size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return operator new (size, alignment, std::nothrow);
+}
+
+__attribute__ ((visibility ("hidden"))) void* operator new (const size_t size, const std::align_val_t alignment)
+{
+    if (void* const ptr = operator new (size, alignment, std::nothrow))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+__attribute__ ((visibility ("hidden"))) void* operator new[] (const size_t size, const std::align_val_t alignment)
+{
+    return operator new (size, alignment);
+}
+
+__attribute__ ((visibility ("hidden"))) void operator delete (void* const ptr, std::align_val_t) noexcept
+{
+    std::free (ptr);
+}
+
+__attribute__ ((visibility ("hidden"))) void operator delete[] (void* const ptr, std::align_val_t) noexcept
+{
+    std::free (ptr);
+}
+
+__attribute__ ((visibility ("hidden"))) void operator delete (void* const ptr, size_t, std::align_val_t) noexcept
+{
+    std::free (ptr);
+}
+
+__attribute__ ((visibility ("hidden"))) void operator delete[] (void* const ptr, size_t, std::align_val_t) noexcept
+{
+    std::free (ptr);
+}
+#endif